@@ -1,2 +1,3 @@
 cp -r * /Applications/Arduino.app/Contents/Resources/Java/libraries/MIDI 
+cp ../shared/* /Applications/Arduino.app/Contents/Resources/Java/libraries/MIDI 
 
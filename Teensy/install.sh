@@ -1,3 +1,4 @@
 cp ./MIDI.* /Applications/Arduino.app/Contents/Resources/Java/libraries/MIDI 
+cp ../shared/* /Applications/Arduino.app/Contents/Resources/Java/libraries/MIDI 
 cd teensy_core/usb_midi
 ./install.sh
\ No newline at end of file
@@ -1,3 +1,4 @@
 cp *.cpp /Applications/Arduino.app/Contents/Resources/Java/hardware/teensy/cores/usb_midi/
 cp *.c /Applications/Arduino.app/Contents/Resources/Java/hardware/teensy/cores/usb_midi/
-cp *.h /Applications/Arduino.app/Contents/Resources/Java/hardware/teensy/cores/usb_midi/
\ No newline at end of file
+cp *.h /Applications/Arduino.app/Contents/Resources/Java/hardware/teensy/cores/usb_midi/
+cp ../../../shared/* /Applications/Arduino.app/Contents/Resources/Java/hardware/teensy/cores/usb_midi/
\ No newline at end of file
@@ -265,6 +265,4 @@ uint8_t usb_serial_class::rts(void)
 // Preinstantiate Objects //////////////////////////////////////////////////////
 
 usb_serial_class	usbSerial = usb_serial_class();
-MIDI_Class			usbMIDI = MIDI_Class();
-//usb_midi_class		usbMIDI = usb_midi_class();
 
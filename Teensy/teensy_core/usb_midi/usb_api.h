@@ -5,9 +5,6 @@
 
 #include "Print.h"
 
-class MIDI_Class;
-extern MIDI_Class usbMIDI;
-
 class usb_serial_class : public Print
 {
 public:
@@ -32,5 +29,8 @@ private:
 
 extern usb_serial_class usbSerial;
 
+// The MIDI interface is bound to usbSerial, see usb_midi.h
+#include "usb_midi.h"
+
 
 #endif
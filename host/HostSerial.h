@@ -0,0 +1,79 @@
+/*!
+ *  @file		HostSerial.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Memory backed serial port for host builds
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ *
+ *  Implements the SerialPort interface expected by MIDI_Interface on top of
+ *  memory buffers, so the shared core can be benchmarked and fuzzed on a PC.
+ */
+
+#ifndef LIB_MIDI_HOST_SERIAL_H_
+#define LIB_MIDI_HOST_SERIAL_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+
+
+/*! \brief Serial port reading from a byte array and writing to another one.
+
+ available() never reports more than RxWindow bytes, like a UART whose RX
+ buffer is refilled by its interrupt, so the parser never sees a "full"
+ buffer and never flushes the input. Written bytes are stored in the output
+ buffer (wrapping around when it is full) and counted.
+ */
+class HostSerial {
+
+public:
+
+	enum { RxWindow = 64 };
+
+	HostSerial(uint8_t * outBuffer, unsigned outSize)
+		: mIn(NULL), mInLength(0), mInIndex(0)
+		, mOut(outBuffer), mOutSize(outSize), mOutIndex(0), mWritten(0) { }
+
+	// SerialPort interface
+	void begin(long) { }
+	int available() {
+		unsigned left = mInLength - mInIndex;
+		return (left > (unsigned)RxWindow) ? (unsigned)RxWindow : left;
+	}
+	int read() {
+		if (mInIndex >= mInLength) return -1;
+		return mIn[mInIndex++];
+	}
+	void flush() { mInIndex = mInLength; }
+	void write(uint8_t c) {
+		mOut[mOutIndex++] = c;
+		if (mOutIndex == mOutSize) mOutIndex = 0;
+		mWritten++;
+	}
+
+	// Host side
+	void feed(const uint8_t * inData, unsigned inLength) {
+		mIn = inData;
+		mInLength = inLength;
+		mInIndex = 0;
+	}
+	void rewindOutput() { mOutIndex = 0; mWritten = 0; }
+	unsigned long written() const { return mWritten; }
+	const uint8_t * output() const { return mOut; }
+
+private:
+
+	const uint8_t *		mIn;
+	unsigned			mInLength;
+	unsigned			mInIndex;
+
+	uint8_t *			mOut;
+	unsigned			mOutSize;
+	unsigned			mOutIndex;
+	unsigned long		mWritten;
+
+};
+
+
+#endif // LIB_MIDI_HOST_SERIAL_H_
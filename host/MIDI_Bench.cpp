@@ -0,0 +1,268 @@
+/*!
+ *  @file		MIDI_Bench.cpp
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Host throughput benchmark
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ *
+ *  Replays MIDI streams through the parser (read() with Thru off), the Soft
+ *  Thru (read() with Thru on, re-sent and cut-through) and the sender (send(), sendSysEx(), ...), and
+ *  reports ns/byte, messages/s and heap allocations for each of them.
+ *
+ *  Build and run from this directory:
+ *		g++ -O2 -I../shared MIDI_Bench.cpp -o MIDI_Bench
+ *		./MIDI_Bench [recorded_stream.bin ...]
+ *
+ *  Recorded streams are raw MIDI byte dumps, as captured from a MIDI port
+ *  (eg: amidi --dump, or a .syx file).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <new>
+#include <vector>
+
+#include "HostSerial.h"
+#include "MIDI_Core.h"
+
+
+// Heap allocation counter: the library must never allocate.
+static unsigned long gAllocations = 0;
+
+void * operator new(size_t size) {
+	gAllocations++;
+	void * p = malloc(size ? size : 1);
+	if (p == NULL) throw std::bad_alloc();
+	return p;
+}
+void operator delete(void * p) throw() { free(p); }
+#if __cplusplus >= 201402L
+void operator delete(void * p, size_t) throw() { free(p); }
+#endif
+
+
+struct CutThroughSettings : public MIDI_DefaultSettings {
+	static const bool ThruCutThrough = true;
+};
+
+typedef MIDI_Interface<HostSerial> BenchMIDI;
+typedef MIDI_Interface<HostSerial, CutThroughSettings> BenchCutThroughMIDI;
+
+static uint8_t				gOutput[4096];
+static HostSerial			gSerial(gOutput,sizeof(gOutput));
+static BenchMIDI			gMIDI(gSerial);
+static BenchCutThroughMIDI	gCutThroughMIDI(gSerial);
+
+
+// A decoded message, replayed through the sender.
+struct BenchMessage {
+	kMIDIType	type;
+	byte		data1;
+	byte		data2;
+	byte		channel;
+	unsigned	sysex;		// Offset of the SysEx data in the SysEx pool
+};
+
+struct BenchStream {
+	const char *				name;
+	std::vector<uint8_t>		bytes;
+	std::vector<BenchMessage>	messages;
+	std::vector<byte>			sysex_pool;
+};
+
+
+static double now_ns() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/* ####### STREAMS ####### */
+
+// NoteOn / NoteOff pairs on all channels, each with its status byte.
+static void make_dense_notes(BenchStream & s) {
+	s.name = "dense notes";
+	for (unsigned i=0;i<20000;i++) {
+		byte channel = i & 0x0F;
+		byte note = 36 + (i % 48);
+		s.bytes.push_back(0x90 | channel); s.bytes.push_back(note); s.bytes.push_back(100);
+		s.bytes.push_back(0x80 | channel); s.bytes.push_back(note); s.bytes.push_back(64);
+	}
+}
+
+// Controller sweeps on one channel, status byte sent once (running status).
+static void make_cc_sweep(BenchStream & s) {
+	s.name = "running status CC sweep";
+	s.bytes.push_back(0xB0);
+	for (unsigned i=0;i<40000;i++) {
+		s.bytes.push_back((i >> 7) & 0x1F);
+		s.bytes.push_back(i & 0x7F);
+	}
+}
+
+// Notes with Clock bytes interleaved inside the messages.
+static void make_interleaved_clock(BenchStream & s) {
+	s.name = "interleaved clock";
+	for (unsigned i=0;i<20000;i++) {
+		byte note = 36 + (i % 48);
+		s.bytes.push_back(0x91);
+		if (i % 3 == 0) s.bytes.push_back(0xF8);
+		s.bytes.push_back(note);
+		if (i % 3 == 1) s.bytes.push_back(0xF8);
+		s.bytes.push_back(i & 0x7F);
+		if (i % 3 == 2) s.bytes.push_back(0xF8);
+	}
+}
+
+// Large SysEx dumps filling most of the default buffer.
+static void make_large_sysex(BenchStream & s) {
+	s.name = "large SysEx";
+	for (unsigned i=0;i<500;i++) {
+		s.bytes.push_back(0xF0);
+		for (unsigned j=0;j<240;j++) s.bytes.push_back((i + j) & 0x7F);
+		s.bytes.push_back(0xF7);
+	}
+}
+
+static bool load_recorded(BenchStream & s, const char * path) {
+	FILE * f = fopen(path,"rb");
+	if (f == NULL) return false;
+	s.name = path;
+	int c;
+	while ((c = fgetc(f)) != EOF) s.bytes.push_back((uint8_t)c);
+	fclose(f);
+	return true;
+}
+
+// Decode the stream once to get the messages replayed by the sender benchmark.
+static void decode(BenchStream & s) {
+	gMIDI.begin(MIDI_CHANNEL_OMNI);
+	gMIDI.turnThruOff();
+	gSerial.feed(&s.bytes[0],s.bytes.size());
+	while (gSerial.available()) {
+		if (!gMIDI.read()) continue;
+		BenchMessage m;
+		m.type = gMIDI.getType();
+		m.data1 = gMIDI.getData1();
+		m.data2 = gMIDI.getData2();
+		m.channel = gMIDI.getChannel();
+		m.sysex = s.sysex_pool.size();
+		if (m.type == SystemExclusive) {
+			s.sysex_pool.insert(s.sysex_pool.end(),gMIDI.getSysExArray(),gMIDI.getSysExArray() + m.data1);
+		}
+		s.messages.push_back(m);
+	}
+}
+
+
+/* ####### BENCHMARKS ####### */
+
+struct BenchResult {
+	unsigned long	bytes;
+	unsigned long	messages;
+	unsigned long	allocations;
+	double			ns;
+};
+
+static void report(const char * path, const BenchResult & r) {
+	printf("  %-10s %9.2f ns/byte %10.3f Mmsg/s %10lu allocs\n",
+		   path,
+		   r.ns / r.bytes,
+		   r.messages / (r.ns / 1e9) / 1e6,
+		   r.allocations);
+}
+
+// Minimum run time for each measure, repeats the stream as needed.
+static const double kMinRunTime_ns = 200e6;
+
+template<class Interface>
+static BenchResult bench_read(Interface & inMIDI, BenchStream & s, bool inThru) {
+	BenchResult r = { 0, 0, 0, 0 };
+	inMIDI.begin(MIDI_CHANNEL_OMNI);
+	if (!inThru) inMIDI.turnThruOff();
+
+	unsigned long allocs = gAllocations;
+	double start = now_ns();
+	do {
+		gSerial.feed(&s.bytes[0],s.bytes.size());
+		while (gSerial.available()) {
+			if (inMIDI.read()) r.messages++;
+		}
+		r.bytes += s.bytes.size();
+		r.ns = now_ns() - start;
+	} while (r.ns < kMinRunTime_ns);
+	r.allocations = gAllocations - allocs;
+	return r;
+}
+
+static BenchResult bench_send(BenchStream & s) {
+	BenchResult r = { 0, 0, 0, 0 };
+	gMIDI.begin(MIDI_CHANNEL_OMNI);
+	gSerial.rewindOutput();
+
+	unsigned long allocs = gAllocations;
+	double start = now_ns();
+	do {
+		for (unsigned i=0;i<s.messages.size();i++) {
+			const BenchMessage & m = s.messages[i];
+			switch (m.type) {
+				case SystemExclusive:
+					gMIDI.sendSysEx(m.data1,&s.sysex_pool[m.sysex],true);
+					break;
+				case SongPosition:
+					gMIDI.sendSongPosition(m.data1 | ((unsigned)m.data2 << 7));
+					break;
+				case SongSelect:
+					gMIDI.sendSongSelect(m.data1);
+					break;
+				case TimeCodeQuarterFrame:
+					gMIDI.sendTimeCodeQuarterFrame(m.data1);
+					break;
+				default:
+					gMIDI.send(m.type,m.data1,m.data2,m.channel);
+					break;
+			}
+		}
+		r.messages += s.messages.size();
+		r.ns = now_ns() - start;
+	} while (r.ns < kMinRunTime_ns);
+	r.allocations = gAllocations - allocs;
+	r.bytes = gSerial.written();
+	return r;
+}
+
+
+int main(int argc, char ** argv) {
+
+	std::vector<BenchStream> streams(4);
+	make_dense_notes(streams[0]);
+	make_cc_sweep(streams[1]);
+	make_interleaved_clock(streams[2]);
+	make_large_sysex(streams[3]);
+
+	for (int i=1;i<argc;i++) {
+		BenchStream s;
+		if (!load_recorded(s,argv[i]) || s.bytes.empty()) {
+			fprintf(stderr,"Cannot read %s\n",argv[i]);
+			return 1;
+		}
+		streams.push_back(s);
+	}
+
+	for (unsigned i=0;i<streams.size();i++) {
+		BenchStream & s = streams[i];
+		decode(s);
+		printf("%s (%lu bytes, %lu messages)\n",s.name,(unsigned long)s.bytes.size(),(unsigned long)s.messages.size());
+		report("parse",bench_read(gMIDI,s,false));
+		report("thru",bench_read(gMIDI,s,true));
+		report("cut-thru",bench_read(gCutThroughMIDI,s,true));
+		report("send",bench_send(s));
+	}
+
+	return 0;
+}
@@ -0,0 +1,293 @@
+/*!
+ *  @file		MIDI_Fuzz.cpp
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Parser fuzzing harness
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ *
+ *  Feeds arbitrary bytes to read() and checks the parser invariants after
+ *  each byte: pending message index in bounds, valid types, channels and data
+ *  bytes of the received messages, and progress (each read() consumes at least
+ *  one byte). The Soft Thru output (re-sent and cut-through) is parsed again
+ *  and must give back the received messages.
+ *  Any violation aborts, so the fuzzer keeps the input.
+ *
+ *  libFuzzer, from this directory:
+ *		clang++ -g -O1 -fsanitize=fuzzer,address,undefined -DMIDI_FUZZ_LIBFUZZER -I../shared MIDI_Fuzz.cpp -o MIDI_Fuzz
+ *		./MIDI_Fuzz corpus/
+ *
+ *  AFL (reads the file given as argument, or stdin):
+ *		afl-clang-fast++ -O2 -I../shared MIDI_Fuzz.cpp -o MIDI_Fuzz
+ *		afl-fuzz -i corpus -o findings ./MIDI_Fuzz @@
+ *
+ *  Worst case per-byte cost of adversarial streams:
+ *		g++ -O2 -I../shared MIDI_Fuzz.cpp -o MIDI_Fuzz
+ *		./MIDI_Fuzz --bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "HostSerial.h"
+#include "MIDI_Core.h"
+
+
+/* Small SysEx buffer, so the overflow path is reached often. */
+struct FuzzSettings : public MIDI_DefaultSettings {
+	static const unsigned SysExMaxSize = 32;
+};
+
+/* Same, with the cut-through Thru. */
+struct FuzzCutThroughSettings : public FuzzSettings {
+	static const bool ThruCutThrough = true;
+};
+
+
+#define FUZZ_CHECK(cond)	do { if (!(cond)) { fprintf(stderr,"%s:%d: invariant failed: %s\n",__FILE__,__LINE__,#cond); abort(); } } while (0)
+
+
+/*! \brief MIDI_Interface with access to the parser state. */
+template<class Settings>
+class FuzzMIDI : public MIDI_Interface<HostSerial, Settings> {
+
+	typedef MIDI_Interface<HostSerial, Settings> Interface;
+	typedef MIDI_Parser<Settings::UseStatistics> Parser;
+
+	using Parser::mPendingMessage;
+	using Parser::mPendingMessageIndex;
+	using Parser::mPendingMessageExpectedLenght;
+	using Parser::mRunningStatus_RX;
+
+public:
+
+	using Interface::getType;
+	using Interface::getChannel;
+	using Interface::getData1;
+	using Interface::getData2;
+	using Interface::getSysExArray;
+
+	FuzzMIDI(HostSerial & inSerial) : Interface(inSerial) { }
+
+	void check_state() {
+		FUZZ_CHECK(mPendingMessageIndex < FuzzSettings::SysExMaxSize);
+		if (mPendingMessageIndex != 0) {
+			FUZZ_CHECK(mPendingMessageIndex < mPendingMessageExpectedLenght);
+			FUZZ_CHECK(mPendingMessage[0] >= 0x80);
+			for (unsigned i=1;i<mPendingMessageIndex;i++) FUZZ_CHECK(mPendingMessage[i] < 0x80);
+		}
+		FUZZ_CHECK(mRunningStatus_RX == InvalidType || (mRunningStatus_RX >= 0x80 && mRunningStatus_RX < 0xF0));
+	}
+
+	void check_message() {
+		const kMIDIType type = getType();
+		FUZZ_CHECK(type != InvalidType);
+		FUZZ_CHECK(Interface::getTypeFromStatusByte(type) == type || type < SystemExclusive);
+		if (type < SystemExclusive) {
+			FUZZ_CHECK(getChannel() >= 1 && getChannel() <= 16);
+			FUZZ_CHECK(getData1() < 0x80 && getData2() < 0x80);
+			if (type == ProgramChange || type == AfterTouchChannel) FUZZ_CHECK(getData2() == 0);
+		}
+		else if (type == SystemExclusive) {
+			const unsigned length = getData1();
+			const byte * array = getSysExArray();
+			FUZZ_CHECK(length >= 2 && length <= FuzzSettings::SysExMaxSize);
+			FUZZ_CHECK(array[0] == 0xF0 && array[length-1] == 0xF7);
+			for (unsigned i=1;i<length-1;i++) FUZZ_CHECK(array[i] < 0x80);
+		}
+		else {
+			FUZZ_CHECK(getData1() < 0x80 && getData2() < 0x80);
+		}
+	}
+
+};
+
+
+// A received message, with its SysEx data.
+struct FuzzMessage {
+	kMIDIType			type;
+	byte				channel;
+	byte				data1;
+	byte				data2;
+	std::vector<byte>	sysex;
+
+	bool operator==(const FuzzMessage & other) const {
+		return type == other.type && channel == other.channel && data1 == other.data1 && data2 == other.data2 && sysex == other.sysex;
+	}
+};
+
+template<class Settings>
+static FuzzMessage get_message(FuzzMIDI<Settings> & inMIDI) {
+	FuzzMessage m;
+	m.type = inMIDI.getType();
+	m.channel = (m.type < SystemExclusive) ? inMIDI.getChannel() : 0;
+	m.data1 = inMIDI.getData1();
+	m.data2 = inMIDI.getData2();
+	if (m.type == SystemExclusive) m.sysex.assign(inMIDI.getSysExArray(),inMIDI.getSysExArray() + m.data1);
+	return m;
+}
+
+// Read the whole input, checking the invariants. Returns the received messages.
+template<class Settings>
+static std::vector<FuzzMessage> read_all(FuzzMIDI<Settings> & inMIDI, HostSerial & inSerial, const uint8_t * inData, size_t inSize) {
+	std::vector<FuzzMessage> messages;
+	inSerial.feed(inData,inSize);
+	size_t reads = 0;
+	while (inSerial.available()) {
+		if (inMIDI.read()) {
+			inMIDI.check_message();
+			messages.push_back(get_message(inMIDI));
+		}
+		inMIDI.check_state();
+		FUZZ_CHECK(++reads <= inSize);	// No stall: each read() consumes at least one byte.
+	}
+	return messages;
+}
+
+
+// Read the input with the Thru on, the Thru output must give back the same messages.
+template<class Settings>
+static void check_thru(const uint8_t * data, size_t size) {
+
+	// Thru output: at most 3 bytes per message, and each message uses at least one byte.
+	std::vector<uint8_t> thru(3 * size + 1);
+	HostSerial serial(&thru[0],thru.size());
+	FuzzMIDI<Settings> midi(serial);
+	midi.begin(MIDI_CHANNEL_OMNI);
+	midi.turnThruOn(Full);
+
+	const std::vector<FuzzMessage> received = read_all(midi,serial,data,size);
+	FUZZ_CHECK(serial.written() < thru.size());
+
+	// The Thru output must give back the same messages.
+	std::vector<uint8_t> unused(1);
+	HostSerial check_serial(&unused[0],unused.size());
+	FuzzMIDI<FuzzSettings> check(check_serial);
+	check.begin(MIDI_CHANNEL_OMNI);
+	check.turnThruOff();
+	const std::vector<FuzzMessage> rethru = read_all(check,check_serial,serial.output(),serial.written());
+	FUZZ_CHECK(rethru.size() == received.size());
+	for (size_t i=0;i<received.size();i++) FUZZ_CHECK(rethru[i] == received[i]);
+}
+
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
+	check_thru<FuzzSettings>(data,size);
+	check_thru<FuzzCutThroughSettings>(data,size);
+	return 0;
+}
+
+
+#ifndef MIDI_FUZZ_LIBFUZZER
+
+/* ####### WORST CASE BENCHMARK ####### */
+
+static double now_ns() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench(const char * inName, const std::vector<uint8_t> & inPattern) {
+
+	// Repeat the pattern to about 64kB.
+	std::vector<uint8_t> stream;
+	while (stream.size() < 65536) stream.insert(stream.end(),inPattern.begin(),inPattern.end());
+	stream.resize(65536);
+
+	static uint8_t output[4096];
+	HostSerial serial(output,sizeof(output));
+	MIDI_Interface<HostSerial> midi(serial);
+	midi.begin(MIDI_CHANNEL_OMNI);
+
+	// Time each window of RxWindow bytes. The fastest of the passes is kept for
+	// each window (to filter out the OS noise), the worst case is the slowest window.
+	const unsigned passes = 20;
+	std::vector<double> window(stream.size() / HostSerial::RxWindow,1e30);
+	double total = 0;
+	for (unsigned pass=0;pass<passes;pass++) {
+		for (size_t w=0;w<window.size();w++) {
+			serial.feed(&stream[w * HostSerial::RxWindow],HostSerial::RxWindow);
+			const double start = now_ns();
+			while (serial.available()) midi.read();
+			const double elapsed = now_ns() - start;
+			total += elapsed;
+			if (elapsed < window[w]) window[w] = elapsed;
+		}
+	}
+	double worst = 0;
+	for (size_t w=0;w<window.size();w++) if (window[w] > worst) worst = window[w];
+	printf("  %-28s %8.2f ns/byte average %8.2f ns/byte worst\n",inName,total / (passes * stream.size()),worst / HostSerial::RxWindow);
+}
+
+static void run_bench() {
+
+	std::vector<uint8_t> p;
+
+	p.clear();
+	for (unsigned i=0;i<64;i++) { p.push_back(0x90); p.push_back(i); p.push_back(100); }
+	bench("notes (reference)",p);
+
+	p.clear();
+	srand(1);
+	for (unsigned i=0;i<4096;i++) p.push_back(rand() & 0xFF);
+	bench("random bytes",p);
+
+	p.clear();
+	p.push_back(0xF0); p.push_back(0xF7);
+	bench("empty SysEx",p);
+
+	p.clear();
+	p.push_back(0xF0);
+	for (unsigned i=0;i<MIDI_DefaultSettings::SysExMaxSize;i++) p.push_back(i & 0x7F);
+	bench("overflowing SysEx",p);
+
+	p.clear();
+	p.push_back(0x90); p.push_back(0x91); p.push_back(0x01);
+	bench("interrupted messages",p);
+
+	p.clear();
+	p.push_back(0xF4); p.push_back(0xF5); p.push_back(0xF9); p.push_back(0xFD); p.push_back(0xF7); p.push_back(0x01);
+	bench("undefined and orphan bytes",p);
+
+	p.clear();
+	p.push_back(0xB0); p.push_back(0xF8); p.push_back(0x07); p.push_back(0xFE); p.push_back(0x40);
+	bench("interleaved real time",p);
+}
+
+
+/* ####### STANDALONE DRIVER (AFL, corpus replay) ####### */
+
+static int run_file(FILE * inFile) {
+	std::vector<uint8_t> data;
+	int c;
+	while ((c = fgetc(inFile)) != EOF) data.push_back((uint8_t)c);
+	return LLVMFuzzerTestOneInput(data.empty() ? NULL : &data[0],data.size());
+}
+
+int main(int argc, char ** argv) {
+
+	if (argc > 1 && strcmp(argv[1],"--bench") == 0) {
+		run_bench();
+		return 0;
+	}
+
+	if (argc == 1) return run_file(stdin);
+
+	for (int i=1;i<argc;i++) {
+		FILE * f = fopen(argv[i],"rb");
+		if (f == NULL) {
+			fprintf(stderr,"Cannot read %s\n",argv[i]);
+			return 1;
+		}
+		run_file(f);
+		fclose(f);
+	}
+	return 0;
+}
+
+#endif // MIDI_FUZZ_LIBFUZZER
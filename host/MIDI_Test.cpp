@@ -0,0 +1,1152 @@
+/*!
+ *  @file		MIDI_Test.cpp
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Host checks of the optional components
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ *
+ *  Runs the components built on top of MIDI_Interface (clock, time code,
+ *  files, controllers...) against HostSerial and a simulated time, and checks
+ *  their output. Any failure aborts with its line.
+ *
+ *  From this directory:
+ *		g++ -O1 -fsanitize=address,undefined -I../shared MIDI_Test.cpp -o MIDI_Test
+ *		./MIDI_Test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HostSerial.h"
+
+/* Simulated time, advanced by the checks. */
+static unsigned long test_micros = 0;
+#define MIDI_MILLIS()		(test_micros / 1000)
+#define MIDI_MICROS()		test_micros
+
+#include "MIDI_Core.h"
+
+
+#define TEST_CHECK(cond)	do { if (!(cond)) { fprintf(stderr,"%s:%d: check failed: %s\n",__FILE__,__LINE__,#cond); abort(); } } while (0)
+
+typedef MIDI_Interface<HostSerial> TestMIDI;
+
+struct TestStatisticsSettings : public MIDI_DefaultSettings {
+	static const bool UseStatistics = true;
+};
+typedef MIDI_Interface<HostSerial,TestStatisticsSettings> TestStatisticsMIDI;
+
+static uint8_t test_output[4096];
+
+// Number of inByte bytes written since the last rewindOutput().
+static unsigned count_bytes(const HostSerial & inSerial, uint8_t inByte) {
+	TEST_CHECK(inSerial.written() <= sizeof(test_output));
+	unsigned count = 0;
+	for (unsigned long i=0;i<inSerial.written();i++) if (inSerial.output()[i] == inByte) count++;
+	return count;
+}
+
+// True if the output since the last call is inExpected, then rewinds it.
+static bool sent(HostSerial & ioSerial, const uint8_t * inExpected, unsigned inLength) {
+	const bool same = ioSerial.written() == inLength && memcmp(ioSerial.output(),inExpected,inLength) == 0;
+	ioSerial.rewindOutput();
+	return same;
+}
+
+
+/* ####### Thru and MIDI_Router ####### */
+
+static void test_router() {
+
+	TEST_CHECK(MIDI_CHANNEL_BIT(1) == 0x0001 && MIDI_CHANNEL_BIT(16) == 0x8000);
+
+	static uint8_t output0[64], output1[64], output2[64];
+	HostSerial serial0(output0,sizeof(output0)), serial1(output1,sizeof(output1)), serial2(output2,sizeof(output2));
+	TestMIDI midi0(serial0), midi1(serial1), midi2(serial2);
+	midi0.begin(1);
+	midi1.begin(1);
+	midi2.begin(1);
+
+	// Local Thru: DifferentChannel drops the input channel only.
+	static const uint8_t stream[] = { 0x90,1,2, 0x91,3,4, 0xF8, 0xF1,0x35, 0x9F,5,6 };
+	midi0.turnThruOn(DifferentChannel);
+	serial0.feed(stream,sizeof(stream));
+	while (serial0.available()) midi0.read();
+	static const uint8_t different[] = { 0x91,3,4, 0xF8, 0xF1,0x35, 0x9F,5,6 };
+	TEST_CHECK(sent(serial0,different,sizeof(different)));
+
+	// Port 0 to ports 1 and 2, its Note On of channel 2 also to port 1 on channel 10,
+	// and its channel 16 to port 2 on channel 3.
+	MIDI_Router router;
+	router.setPort(0,midi0);
+	router.setPort(1,midi1);
+	router.setPort(2,midi2);
+	TEST_CHECK(router.addRoute(MIDI_PORT_BIT(0),MIDI_ALL_CHANNELS,MIDI_ALL_TYPES,MIDI_PORT_BIT(1) | MIDI_PORT_BIT(2)));
+	TEST_CHECK(router.addRoute(MIDI_PORT_BIT(0),MIDI_CHANNEL_BIT(2),MIDI_TYPE_BIT(NoteOn),MIDI_PORT_BIT(1),10));
+	TEST_CHECK(router.addRoute(MIDI_PORT_BIT(0),MIDI_CHANNEL_BIT(16),MIDI_CHANNEL_TYPES,MIDI_PORT_BIT(2),3));
+	// Same outputs and channel as the first route: not sent twice.
+	TEST_CHECK(router.addRoute(MIDI_PORT_BIT(0),MIDI_ALL_CHANNELS,MIDI_REALTIME_TYPES,MIDI_PORT_BIT(1)));
+	static const uint8_t sysex[] = { 0xF0,1,2,0xF7 };
+	midi0.turnThruOn();
+	serial0.feed(stream,sizeof(stream));
+	while (serial0.available()) midi0.read();
+	serial0.feed(sysex,sizeof(sysex));
+	while (serial0.available()) midi0.read();
+	TEST_CHECK(serial0.written() == 0);
+	static const uint8_t routed1[] = { 0x90,1,2, 0x91,3,4, 0x99,3,4, 0xF8, 0xF1,0x35, 0x9F,5,6, 0xF0,1,2,0xF7 };
+	TEST_CHECK(sent(serial1,routed1,sizeof(routed1)));
+	static const uint8_t routed2[] = { 0x90,1,2, 0x91,3,4, 0xF8, 0xF1,0x35, 0x9F,5,6, 0x92,5,6, 0xF0,1,2,0xF7 };
+	TEST_CHECK(sent(serial2,routed2,sizeof(routed2)));
+}
+
+
+/* ####### MIDI_Merger ####### */
+
+static void test_merger() {
+
+	static uint8_t merged[256];
+	static uint8_t output_a[16], output_b[16];
+	HostSerial serial(merged,sizeof(merged)), serial_a(output_a,sizeof(output_a)), serial_b(output_b,sizeof(output_b));
+	TestStatisticsMIDI midi(serial);
+	TestMIDI midi_a(serial_a), midi_b(serial_b);
+	midi.begin(1);
+	midi_a.begin(5);
+	midi_b.begin(1);
+
+	MIDI_Merger merger;
+	merger.setOutput(midi);
+	TEST_CHECK(merger.addInput(midi_a));
+	TEST_CHECK(merger.addInput(midi_b));
+
+	// Input A: a SysEx of 38 bytes (3 chunks), then a Note On.
+	// Input B: Real Time, notes held until the end of the SysEx, then more Real Time.
+	uint8_t stream_a[64];
+	unsigned length = 0;
+	stream_a[length++] = 0xF0;
+	for (byte i=0;i<36;i++) stream_a[length++] = i;
+	stream_a[length++] = 0xF7;
+	stream_a[length++] = 0x90;
+	stream_a[length++] = 60;
+	stream_a[length++] = 1;
+	static const uint8_t stream_b[] = { 0xF8, 0xFE, 0x90,1,2, 3,4, 0xF8, 0xF8, 0x92,5,6, 0xF8 };
+	serial_a.feed(stream_a,length);
+	serial_b.feed(stream_b,sizeof(stream_b));
+	for (unsigned i=0;i<20;i++) merger.update();
+
+	uint8_t expected[64];
+	unsigned count = 0;
+	expected[count++] = 0xF8;
+	for (byte i=0;i<16;i++) expected[count++] = stream_a[i];		// First chunk
+	expected[count++] = 0xFE;										// Real Time between the chunks
+	for (byte i=16;i<38;i++) expected[count++] = stream_a[i];
+	static const uint8_t end[] = { 0x90,1,2, 60,1, 3,4, 0xF8, 0xF8, 0x92,5,6, 0xF8 };	// Running status kept across the inputs
+	for (byte i=0;i<sizeof(end);i++) expected[count++] = end[i];
+	TEST_CHECK(serial.written() == count && memcmp(merged,expected,count) == 0);
+
+	// The SysEx is counted once, not once per chunk.
+	MIDI_Statistics statistics;
+	midi.getStatistics(statistics);
+	TEST_CHECK(statistics.sent(SystemExclusive) == 1);
+	TEST_CHECK(statistics.sent(NoteOn) == 4 && statistics.sent(Clock) == 4 && statistics.sent(ActiveSensing) == 1);
+}
+
+
+/* ####### Running status ####### */
+
+static void test_running_status_refresh() {
+
+	HostSerial serial(test_output,sizeof(test_output));
+	TestMIDI midi(serial);
+	midi.begin(1);
+	test_micros = 0;
+
+	// By default, the status byte is only sent when it changes.
+	for (byte i=0;i<4;i++) midi.sendControlChange(7,i,1);
+	static const uint8_t kept[] = { 0xB0,7,0, 7,1, 7,2, 7,3 };
+	TEST_CHECK(sent(serial,kept,sizeof(kept)));
+
+	// Every 3 messages.
+	midi.setRunningStatusRefresh(3);
+	for (byte i=0;i<7;i++) midi.sendControlChange(7,i,1);
+	static const uint8_t counted[] = { 7,0, 7,1, 0xB0,7,2, 7,3, 7,4, 0xB0,7,5, 7,6 };
+	TEST_CHECK(sent(serial,counted,sizeof(counted)));
+
+	// After 100 ms without a status byte.
+	midi.setRunningStatusRefresh(0,100);
+	test_micros = 99000;
+	midi.sendControlChange(7,10,1);
+	test_micros = 100000;
+	midi.sendControlChange(7,11,1);
+	test_micros = 150000;
+	midi.sendControlChange(7,12,1);
+	test_micros = 199000;
+	midi.sendControlChange(7,13,1);
+	test_micros = 200000;
+	midi.sendControlChange(7,14,1);
+	static const uint8_t timed[] = { 7,10, 0xB0,7,11, 7,12, 7,13, 0xB0,7,14 };
+	TEST_CHECK(sent(serial,timed,sizeof(timed)));
+
+	// A new status restarts the interval.
+	test_micros = 250000;
+	midi.sendNoteOn(60,100,1);
+	test_micros = 300000;
+	midi.sendNoteOn(61,100,1);
+	static const uint8_t changed[] = { 0x90,60,100, 61,100 };
+	TEST_CHECK(sent(serial,changed,sizeof(changed)));
+}
+
+
+/* ####### Note Off as Note On ####### */
+
+struct TestNoteOffSettings : public TestStatisticsSettings {
+	static const bool NoteOffAsNoteOn = true;
+};
+
+static void test_note_off_as_note_on() {
+
+	HostSerial serial(test_output,sizeof(test_output));
+	MIDI_Interface<HostSerial,TestNoteOffSettings> midi(serial);
+	midi.begin(1);
+
+	// Note Off sent as Note On with a null velocity: the running status applies.
+	midi.sendNoteOn(60,100,2);
+	midi.sendNoteOff(60,64,2);
+	midi.sendNoteOff(61,64,3);
+	static const uint8_t notes[] = { 0x91,60,100, 60,0, 0x92,61,0 };
+	TEST_CHECK(sent(serial,notes,sizeof(notes)));
+
+	// Counted as they were asked.
+	MIDI_Statistics statistics;
+	midi.getStatistics(statistics);
+	TEST_CHECK(statistics.sent(NoteOn) == 1 && statistics.sent(NoteOff) == 2);
+}
+
+
+/* ####### Active Sensing ####### */
+
+static unsigned test_connection_lost_count;
+static void test_connection_lost() { test_connection_lost_count++; }
+
+static void test_active_sensing() {
+
+	HostSerial serial(test_output,sizeof(test_output));
+	TestMIDI midi(serial);
+	midi.begin(MIDI_CHANNEL_OMNI);
+	midi.turnThruOff();
+	MIDI_NoteTracker input;
+	midi.setNoteTracker(&input,NULL);
+	midi.setHandleConnectionLost(test_connection_lost);
+	test_connection_lost_count = 0;
+
+	// Not watched before the first Active Sensing.
+	test_micros = 1000000;
+	static const uint8_t note[] = { 0x90,60,100 };
+	serial.feed(note,sizeof(note));
+	while (midi.read()) { }
+	test_micros = 2000000;
+	TEST_CHECK(!midi.read() && !midi.isSensing() && test_connection_lost_count == 0);
+
+	// SensingNotify: only the callback, after more than 300 ms without a byte.
+	static const uint8_t sensing[] = { 0xFE };
+	serial.feed(sensing,sizeof(sensing));
+	while (midi.read()) { }
+	TEST_CHECK(midi.isSensing());
+	test_micros = 2200000;
+	serial.feed(sensing,sizeof(sensing));
+	while (midi.read()) { }
+	test_micros = 2500000;
+	TEST_CHECK(!midi.read() && midi.isSensing());
+	test_micros = 2501000;
+	TEST_CHECK(!midi.read() && !midi.isSensing() && test_connection_lost_count == 1);
+	TEST_CHECK(serial.written() == 0 && input.count() == 1);
+	test_micros = 3000000;
+	TEST_CHECK(!midi.read() && test_connection_lost_count == 1);
+
+	// SensingSendNotesOff and SensingLocalNotesOff: for the channels which received notes since the last timeout.
+	midi.setSensingAction(SensingSendNotesOff | SensingLocalNotesOff);
+	static const uint8_t notes[] = { 0xFE, 0x91,61,100, 0x9F,62,100 };
+	serial.feed(notes,sizeof(notes));
+	while (midi.read()) { }
+	TEST_CHECK(input.count() == 3);
+	test_micros = 3301000;
+	TEST_CHECK(!midi.read() && !midi.isSensing() && test_connection_lost_count == 2);
+	static const uint8_t sent_off[] = { 0xB1,123,0, 0xBF,123,0 };
+	TEST_CHECK(sent(serial,sent_off,sizeof(sent_off)));
+
+	// One All Notes Off per channel returned by read(), and given to the note tracker.
+	TEST_CHECK(midi.read());
+	TEST_CHECK(midi.getType() == ControlChange && midi.getChannel() == 2 && midi.getData1() == 123 && midi.getData2() == 0);
+	TEST_CHECK(input.count() == 2 && input.count(2) == 0);
+	TEST_CHECK(midi.read());
+	TEST_CHECK(midi.getType() == ControlChange && midi.getChannel() == 16 && midi.getData1() == 123);
+	TEST_CHECK(input.count() == 1 && input.isOn(1,60));
+	TEST_CHECK(!midi.read());
+	TEST_CHECK(serial.written() == 0);
+}
+
+
+/* ####### MIDI_ClockMaster ####### */
+
+static void test_clock_master() {
+
+	HostSerial serial(test_output,sizeof(test_output));
+	TestMIDI midi(serial);
+	midi.begin(1);
+	MIDI_ClockMaster<TestMIDI> clock(midi);
+
+	// 120 BPM for 10 s: 480 Clocks, 80 MIDI beats.
+	clock.setTempo(12000);
+	clock.start();
+	TEST_CHECK(serial.written() == 1 && test_output[0] == Start);
+	serial.rewindOutput();
+	for (unsigned i=0;i<40000;i++) clock.tick(250);
+	TEST_CHECK(count_bytes(serial,Clock) == 480);
+	TEST_CHECK(clock.getSongPosition() == 80);
+
+	// Long ticks at a high tempo: inElapsed x tempo is above 2^32.
+	// 153 x 65535 us at 650.00 BPM: 2606.98 Clocks.
+	clock.setTempo(65000);
+	clock.start();
+	serial.rewindOutput();
+	for (unsigned i=0;i<153;i++) clock.tick(0xFFFF);
+	TEST_CHECK(count_bytes(serial,Clock) == 2606);
+
+	// Stopped: the Clock goes on, the position is frozen and moved by setSongPosition().
+	clock.setTempo(12000);
+	clock.stop();
+	const unsigned int position = clock.getSongPosition();
+	clock.tick(50000);
+	TEST_CHECK(clock.getSongPosition() == position);
+	clock.setSongPosition(16);
+	serial.rewindOutput();
+	clock.resume();
+	TEST_CHECK(test_output[0] == Continue);
+	clock.tick(62500);		// 3 Clocks
+	TEST_CHECK(count_bytes(serial,Clock) == 3);
+	TEST_CHECK(clock.getSongPosition() == 16);
+	clock.tick(62500);
+	TEST_CHECK(clock.getSongPosition() == 17);
+
+	// update(): the time counts from its first call, not from the boot.
+	MIDI_ClockMaster<TestMIDI> looped(midi);
+	test_micros = 5000000;
+	serial.rewindOutput();
+	looped.update();
+	TEST_CHECK(serial.written() == 0);
+	test_micros += 1000000;		// More than 0xFFFF us between two calls
+	looped.update();
+	TEST_CHECK(count_bytes(serial,Clock) == 48);
+
+	// Nor from the last update() before start() and resume().
+	looped.stop();
+	test_micros += 1000000;
+	serial.rewindOutput();
+	looped.start();
+	looped.update();
+	TEST_CHECK(serial.written() == 1 && test_output[0] == Start);
+	test_micros += 62500;
+	looped.update();
+	TEST_CHECK(count_bytes(serial,Clock) == 3);
+	looped.stop();
+	test_micros += 1000000;
+	serial.rewindOutput();
+	looped.resume();
+	looped.update();
+	TEST_CHECK(serial.written() == 1 && test_output[0] == Continue);
+}
+
+
+/* ####### MIDI_ClockFollower ####### */
+
+static void test_clock_follower() {
+
+	// Clocks with the same time stamp (eg: no MIDI_MICROS()): no tempo, no division by zero.
+	MIDI_ClockFollower follower;
+	follower.clock(1000);
+	follower.clock(1000);
+	follower.clock(1000);
+	TEST_CHECK(follower.getTempo() == 0);
+	TEST_CHECK(!follower.isLocked());
+
+	// Through the interface: Start then Clock, time stamped by read().
+	static const uint8_t stream[] = { Start, Clock, Clock };
+	HostSerial serial(test_output,sizeof(test_output));
+	TestMIDI midi(serial);
+	midi.begin(1);
+	follower.reset();
+	midi.setClockFollower(&follower);
+	serial.feed(stream,sizeof(stream));
+	test_micros = 1000;
+	TEST_CHECK(midi.read() && midi.read());
+	test_micros += 20000;
+	TEST_CHECK(midi.read());
+	TEST_CHECK(follower.isRunning());
+	TEST_CHECK(follower.getClockPosition() == 1);
+	TEST_CHECK(follower.getClockPeriod() == 20000);
+
+	// 123.40 BPM with +/- 1 ms of jitter, then 140.00 BPM.
+	follower.reset();
+	unsigned long seed = 1;
+	double time = 1000;
+	double period = 60e6 / (24 * 123.4);
+	for (unsigned i=0;i<2000;i++) {
+		if (i == 1000) period = 60e6 / (24 * 140.0);
+		time += period;
+		seed = seed * 1103515245UL + 12345;
+		follower.clock((unsigned long)time + ((seed >> 16) % 2001) - 1000);
+		if (i == 999 || i == 1999) {
+			const long expected = (i == 999) ? 12340 : 14000;
+			TEST_CHECK(follower.isLocked());
+			TEST_CHECK(labs((long)follower.getTempo() - expected) <= expected / 100);
+			// Next beat predicted within 2 ms.
+			const long error = (long)(follower.getTimeOfClock(follower.getClockPosition() + 24) - (unsigned long)(time + 24 * period));
+			TEST_CHECK(labs(error) <= 2000);
+		}
+	}
+
+	// Song Position is only taken when stopped, for the Clock after Continue.
+	follower.received(Start,0,0,0);
+	follower.received(Stop,0,0,0);
+	follower.received(SongPosition,8,0,0);
+	follower.received(Continue,0,0,0);
+	follower.clock((unsigned long)time + 20000);
+	TEST_CHECK(follower.getSongPosition() == 8);
+	follower.received(SongPosition,16,0,0);
+	follower.clock((unsigned long)time + 40000);
+	TEST_CHECK(follower.getClockPosition() == 8 * MIDI_CLOCKS_PER_MIDI_BEAT + 1);
+}
+
+
+/* ####### MIDI Time Code ####### */
+
+static unsigned test_frames = 0;
+static void on_frame(const MIDI_TimeCode &) { test_frames++; }
+
+static bool same_time(const MIDI_TimeCode & inTimeCode, byte inHours, byte inMinutes, byte inSeconds, byte inFrames) {
+	return inTimeCode.hours == inHours && inTimeCode.minutes == inMinutes && inTimeCode.seconds == inSeconds && inTimeCode.frames == inFrames;
+}
+
+static void test_time_code() {
+
+	// Drop frame: frame numbers 0 and 1 are skipped each minute, except every 10 minutes.
+	MIDI_TimeCode timecode = { 0, 10, 0, 0, MTC30Drop };
+	timecode.decrement();
+	TEST_CHECK(same_time(timecode,0,9,59,29));
+	timecode.increment();
+	TEST_CHECK(same_time(timecode,0,10,0,0));
+	timecode.minutes = 1;
+	timecode.frames = 2;
+	timecode.decrement();
+	TEST_CHECK(same_time(timecode,0,0,59,29));
+	timecode.increment();
+	TEST_CHECK(same_time(timecode,0,1,0,2));
+
+	// 2 s of 29.97 fps from 00:08:59:20: a Full Frame, then 239 quarter frames.
+	static uint8_t sent[1024];
+	HostSerial serial(sent,sizeof(sent));
+	TestMIDI midi(serial);
+	midi.begin(1);
+	MIDI_TimeCodeGenerator<TestMIDI> generator(midi);
+	const MIDI_TimeCode start = { 0, 8, 59, 20, MTC30Drop };
+	generator.locate(start);
+	generator.start();
+	for (unsigned i=0;i<8000;i++) generator.tick(250);
+	TEST_CHECK(serial.written() == 10 + 239 * 2);
+	TEST_CHECK(sent[0] == SystemExclusive && sent[10] == TimeCodeQuarterFrame && sent[11] == 0x04);
+	TEST_CHECK(same_time(generator.getTimeCode(),0,9,1,20));
+
+	// Read back: the reader runs with the quarter frames, one frame ahead of the last sequence.
+	HostSerial input(test_output,sizeof(test_output));
+	TestMIDI receiver(input);
+	receiver.begin(1);
+	MIDI_TimeCodeReader reader;
+	reader.setHandleFrame(on_frame);
+	receiver.setTimeCodeReader(&reader);
+	input.feed(sent,serial.written());
+	while (receiver.read()) { }
+	TEST_CHECK(reader.isLocked() && reader.isForward());
+	TEST_CHECK(reader.getTimeCode().rate == MTC30Drop);
+	TEST_CHECK(same_time(reader.getTimeCode(),0,9,1,21));
+	TEST_CHECK(test_frames == 59);
+
+	// Backwards: the quarter frames in reverse order.
+	static uint8_t reversed[1024];
+	unsigned length = 0;
+	for (unsigned i=serial.written()-2;i>=10;i-=2) {
+		reversed[length++] = sent[i];
+		reversed[length++] = sent[i+1];
+	}
+	reader.reset();
+	input.feed(reversed,length);
+	while (receiver.read()) { }
+	TEST_CHECK(reader.isLocked() && !reader.isForward());
+	TEST_CHECK(same_time(reader.getTimeCode(),0,8,59,18));
+
+	// A lost quarter frame unlocks until the next complete sequence.
+	input.feed(sent + 10,32);
+	while (receiver.read()) { }
+	TEST_CHECK(reader.isLocked() && reader.isForward());
+	input.feed(sent + 10 + 34,8);
+	while (receiver.read()) { }
+	TEST_CHECK(!reader.isLocked());
+
+	// update(): the time counts from locate() and start(), not from the boot or the stop.
+	MIDI_TimeCodeGenerator<TestMIDI> looped(midi);
+	test_micros = 5000000;
+	looped.locate(start);
+	looped.start();
+	serial.rewindOutput();
+	looped.update();
+	TEST_CHECK(serial.written() == 0);
+	test_micros += 1000000;
+	looped.update();
+	TEST_CHECK(serial.written() == 119 * 2);		// 1 s at 29.97 fps: 119.88 quarter frames
+	looped.stop();
+	test_micros += 1000000;
+	serial.rewindOutput();
+	looped.start();
+	looped.update();
+	TEST_CHECK(serial.written() == 0);
+	test_micros += 8342;
+	looped.update();
+	TEST_CHECK(serial.written() == 2);
+}
+
+
+/* ####### Standard MIDI Files ####### */
+
+// Output of the player: keeps the scheduled events.
+struct TestSchedule {
+
+	struct Entry {
+		unsigned long	time;
+		kMIDIType		type;
+		byte			data1;
+		byte			data2;
+		byte			channel;
+	};
+
+	Entry	entries[16];
+	byte	count;
+	byte	free;
+
+	TestSchedule() : count(0), free(16) { }
+
+	byte getFree() const { return free; }
+	bool schedule(unsigned long inTime, kMIDIType inType, byte inData1, byte inData2, byte inChannel) {
+		TEST_CHECK(free > 0 && count < 16);
+		free--;
+		const Entry entry = { inTime, inType, inData1, inData2, inChannel };
+		entries[count++] = entry;
+		return true;
+	}
+
+	bool is(byte inIndex, unsigned long inTime, kMIDIType inType, byte inData1, byte inData2, byte inChannel) const {
+		const Entry & e = entries[inIndex];
+		return inIndex < count && e.time == inTime && e.type == inType && e.data1 == inData1 && e.data2 == inData2 && e.channel == inChannel;
+	}
+};
+
+// File kept in memory, written by the recorder.
+struct TestSink {
+	byte			data[1024];
+	unsigned long	position;
+	unsigned long	size;
+
+	TestSink() : position(0), size(0) { }
+
+	bool seek(unsigned long inPosition) { position = inPosition; return true; }
+	unsigned write(const byte * inData, unsigned inLength) {
+		TEST_CHECK(position + inLength <= sizeof(data));
+		memcpy(data + position,inData,inLength);
+		position += inLength;
+		if (position > size) size = position;
+		return inLength;
+	}
+};
+
+static void test_file_player() {
+
+	// Format 1, 480 ticks per quarter note: a tempo track, a note track.
+	static const byte song[] = {
+		'M','T','h','d', 0,0,0,6, 0,1, 0,2, 0x01,0xE0,
+		'M','T','r','k', 0,0,0,19,
+			0x00, 0xFF,0x51,0x03, 0x07,0xA1,0x20,			// 500000 us per quarter note
+			0x83,0x60, 0xFF,0x51,0x03, 0x0F,0x42,0x40,		// At 480: 1000000 us per quarter note
+			0x00, 0xFF,0x2F,0x00,
+		'X','X','X','X', 0,0,0,2, 0,0,						// Unknown chunk, skipped
+		'M','T','r','k', 0,0,0,22,
+			0x00, 0x90,60,100,
+			0x83,0x60, 62,100,								// Running status, at 480
+			0x00, 0xF0,0x02,0x01,0xF7,						// SysEx: cancels the running status
+			0x83,0x60, 0x80,60,0,							// At 960
+			0x00, 0xC1,5,
+			0x00, 0xFF,0x2F,0x00
+	};
+
+	MIDI_FileArray source(song,sizeof(song));
+	TestSchedule output;
+	MIDI_FilePlayer<MIDI_FileArray,TestSchedule> player(source,output);
+	TEST_CHECK(player.open());
+	TEST_CHECK(player.getDivision() == 480);
+
+	// Only what is due within the look ahead, and what fits in the output.
+	player.play(1000);
+	player.update(0);
+	TEST_CHECK(output.count == 1);
+	output.free = 1;
+	player.update(1500000);
+	TEST_CHECK(output.count == 2);
+	TEST_CHECK(!player.isFinished());
+
+	output.free = 8;
+	player.update(1500000);
+	TEST_CHECK(player.isFinished());
+	TEST_CHECK(player.getTick() == 960);
+	TEST_CHECK(output.count == 4);
+	TEST_CHECK(output.is(0,1000,NoteOn,60,100,1));
+	TEST_CHECK(output.is(1,501000,NoteOn,62,100,1));
+	TEST_CHECK(output.is(2,1501000,NoteOff,60,0,1));
+	TEST_CHECK(output.is(3,1501000,ProgramChange,5,0,2));
+}
+
+static void test_file_recorder() {
+
+	static const uint8_t stream[] = { 0x90,60,100, 62,100, 0xF0,1,2,3,0xF7, Clock, 0x80,60,0, 0xC2,7, 0xF2,0x10,0x01 };
+	HostSerial serial(test_output,sizeof(test_output));
+	TestMIDI midi(serial);
+	midi.begin(MIDI_CHANNEL_OMNI);
+	serial.feed(stream,sizeof(stream));
+
+	// Small blocks, so update() writes while recording.
+	TestSink sink;
+	MIDI_FileRecorder<TestSink,16> recorder(sink);
+	TEST_CHECK(recorder.begin(1000));
+	unsigned long now = 1000;
+	unsigned recorded = 0;
+	while (midi.read()) {
+		now += 250;
+		if (recorder.record(midi.getMessage(),now)) recorded++;
+		recorder.update();
+	}
+	TEST_CHECK(recorded == 6);		// Not the Clock
+	TEST_CHECK(recorder.end(now + 500));
+	TEST_CHECK(recorder.getDropped() == 0);
+	TEST_CHECK(sink.size == 67);
+	TEST_CHECK(sink.data[21] == sink.size - 22);		// Track length
+
+	// Played back: 500 ticks per quarter note at 120 BPM, 1 ms per tick.
+	MIDI_FileArray source(sink.data,sink.size);
+	TestSchedule output;
+	MIDI_FilePlayer<MIDI_FileArray,TestSchedule> player(source,output);
+	TEST_CHECK(player.open());
+	player.play(0);
+	player.update(10000000);
+	TEST_CHECK(player.isFinished());
+	TEST_CHECK(output.count == 4);
+	TEST_CHECK(output.is(0,250000,NoteOn,60,100,1));
+	TEST_CHECK(output.is(1,500000,NoteOn,62,100,1));
+	TEST_CHECK(output.is(2,1250000,NoteOff,60,0,1));
+	TEST_CHECK(output.is(3,1500000,ProgramChange,7,0,3));
+
+	// Without update(), the events that don't fit in the two blocks are dropped.
+	TestSink full;
+	MIDI_FileRecorder<TestSink,8> dropping(full);
+	TEST_CHECK(dropping.begin(0));
+	unsigned accepted = 0;
+	for (unsigned i=0;i<10;i++) if (dropping.record(NoteOn,60,1,1,NULL,i)) accepted++;
+	TEST_CHECK(accepted == 1);
+	TEST_CHECK(dropping.getDropped() == 9);
+
+	// A SysEx longer than the two blocks (255 bytes with 64 byte blocks) is written while it is encoded.
+	static byte sysex[255];
+	sysex[0] = 0xF0;
+	for (byte i=1;i<254;i++) sysex[i] = i & 0x7F;
+	sysex[254] = 0xF7;
+	TestSink large;
+	MIDI_FileRecorder<TestSink> recorder_large(large);
+	TEST_CHECK(recorder_large.begin(0));
+	TEST_CHECK(recorder_large.record(NoteOn,60,100,1,NULL,1));
+	TEST_CHECK(recorder_large.record(SystemExclusive,255,0,0,sysex,2));
+	TEST_CHECK(recorder_large.record(NoteOff,60,0,1,NULL,3));
+	TEST_CHECK(recorder_large.end(4));
+	TEST_CHECK(recorder_large.getDropped() == 0);
+	// Header, tempo, note (4), delta + F0 + length (2 bytes) + 254, note (4), end (4).
+	TEST_CHECK(large.size == 22 + 7 + 4 + 1 + 1 + 2 + 254 + 4 + 4);
+	const byte * event = large.data + 22 + 7 + 4;
+	TEST_CHECK(event[0] == 1 && event[1] == 0xF0 && event[2] == 0x81 && event[3] == 0x7E);
+	TEST_CHECK(memcmp(event + 4,sysex + 1,254) == 0);
+	TEST_CHECK(event[4 + 254] == 1 && event[4 + 254 + 1] == 0x80);
+}
+
+
+/* ####### MIDI_NoteTracker ####### */
+
+static void test_note_tracker() {
+
+	HostSerial serial(test_output,sizeof(test_output));
+	TestMIDI midi(serial);
+	midi.begin(MIDI_CHANNEL_OMNI);
+	midi.turnThruOff();
+	MIDI_NoteTracker input, output;
+	midi.setNoteTracker(&input,&output);
+
+	// Received: a Note On with a null velocity is a Note Off.
+	static const uint8_t stream[] = { 0x90,60,100, 0x95,0,1, 127,1, 0x80,60,0, 0x95,127,0 };
+	serial.feed(stream,sizeof(stream));
+	while (midi.read()) { }
+	TEST_CHECK(input.count() == 1);
+	TEST_CHECK(input.count(6) == 1);
+	TEST_CHECK(input.isOn(6,0) && !input.isOn(6,127) && !input.isOn(1,60));
+	TEST_CHECK(input.lowest(6) == 0 && input.highest(6) == 0);
+	TEST_CHECK(input.getChannels() == 0x0020);
+
+	// Sent: releaseAll() sends a Note Off for each held note.
+	midi.sendNoteOn(10,1,2);
+	midi.sendNoteOn(11,1,2);
+	midi.sendNoteOn(100,1,16);
+	midi.sendNoteOn(11,0,2);
+	TEST_CHECK(output.count() == 2);
+	serial.rewindOutput();
+	output.releaseAll(midi);
+	static const uint8_t released[] = { 0x81,10,0, 0x8F,100,0 };
+	TEST_CHECK(serial.written() == sizeof(released) && memcmp(test_output,released,sizeof(released)) == 0);
+	TEST_CHECK(output.count() == 0);
+}
+
+
+/* ####### Controllers ####### */
+
+static void test_controller_cache() {
+
+	HostSerial serial(test_output,sizeof(test_output));
+	TestMIDI midi(serial);
+	midi.begin(1);
+	MIDI_ControllerCache<TestMIDI,2> cache(midi);
+
+	// Only the changes are sent.
+	cache.sendControlChange(7,100,1);
+	cache.sendControlChange(7,100,1);
+	cache.sendControlChange(7,101,1);
+	static const uint8_t changes[] = { 0xB0,7,100, 7,101 };
+	TEST_CHECK(sent(serial,changes,sizeof(changes)));
+
+	cache.setDeadband(1);
+	cache.sendControlChange(7,102,1);
+	cache.sendControlChange(7,103,1);
+	static const uint8_t deadband[] = { 7,103 };
+	TEST_CHECK(sent(serial,deadband,sizeof(deadband)));
+
+	cache.sendPitchBend(0,1);
+	cache.sendPitchBend(100,1);
+	cache.sendPitchBend(200,1);
+	cache.sendPitchBend(-9000,1);
+	static const uint8_t bends[] = { 0xE0,0x00,0x40, 0x48,0x41, 0x00,0x00 };
+	TEST_CHECK(sent(serial,bends,sizeof(bends)));
+
+	// No free entry: sent every time.
+	cache.sendAfterTouch(5,1);
+	cache.sendAfterTouch(5,1);
+	static const uint8_t full[] = { 0xD0,5, 5 };
+	TEST_CHECK(sent(serial,full,sizeof(full)));
+
+	// Rate limited to one message per 10 ms, the last value is sent by update().
+	cache.clear();
+	cache.setDeadband(0);
+	cache.setMinInterval(10);
+	for (unsigned ms=100;ms<150;ms++) {
+		test_micros = ms * 1000UL;
+		cache.sendControlChange(1,ms - 100,1);
+		cache.update();
+	}
+	test_micros = 200000;
+	cache.update();
+	static const uint8_t limited[] = { 0xB0,1,0, 1,10, 1,20, 1,30, 1,40, 1,49 };
+	TEST_CHECK(sent(serial,limited,sizeof(limited)));
+}
+
+struct TestParameter {
+	byte		channel;
+	uint16_t	number;
+	uint16_t	value;
+	bool		nrpn;
+};
+
+static TestParameter test_parameters[8];
+static unsigned test_parameter_count = 0;
+
+static void on_parameter(byte inChannel, uint16_t inNumber, uint16_t inValue, bool inNRPN) {
+	TEST_CHECK(test_parameter_count < 8);
+	const TestParameter parameter = { inChannel, inNumber, inValue, inNRPN };
+	test_parameters[test_parameter_count++] = parameter;
+}
+
+static bool is_parameter(unsigned inIndex, byte inChannel, uint16_t inNumber, uint16_t inValue, bool inNRPN) {
+	const TestParameter & p = test_parameters[inIndex];
+	return inIndex < test_parameter_count && p.channel == inChannel && p.number == inNumber && p.value == inValue && p.nrpn == inNRPN;
+}
+
+static void test_parameters_rpn() {
+
+	static uint8_t stream[256];
+	HostSerial serial(stream,sizeof(stream));
+	TestMIDI midi(serial);
+	midi.begin(1);
+	MIDI_ParameterWriter<TestMIDI> writer(midi);
+
+	// The parameter number is only sent when it changes, and the LSB only when not null.
+	writer.sendRPN(0,12 << 7,1);
+	TEST_CHECK(serial.written() == 9);
+	writer.sendRPN(0,(12 << 7) | 5,1);
+	TEST_CHECK(serial.written() == 9 + 2);
+	writer.sendRPN(0,13 << 7,1);
+	TEST_CHECK(serial.written() == 9 + 2 + 4);
+	writer.sendNRPN(0x1234,1000,2);
+	writer.end(2);
+
+	HostSerial input(test_output,sizeof(test_output));
+	TestMIDI receiver(input);
+	receiver.begin(MIDI_CHANNEL_OMNI);
+	receiver.turnThruOff();
+	MIDI_ParameterReader reader;
+	reader.setHandleParameter(on_parameter);
+	receiver.setParameterReader(&reader);
+	input.feed(stream,serial.written());
+	while (receiver.read()) { }
+	TEST_CHECK(test_parameter_count == 4);
+	TEST_CHECK(is_parameter(0,1,0,12 << 7,false));
+	TEST_CHECK(is_parameter(1,1,0,(12 << 7) | 5,false));
+	TEST_CHECK(is_parameter(2,1,0,13 << 7,false));
+	TEST_CHECK(is_parameter(3,2,0x1234,1000,true));
+
+	// Data Entry MSB only: reported when another message comes, or by flush().
+	static const uint8_t msb[] = { 0xB3,101,0, 100,1, 6,64, 0x93,60,1, 0xB3,6,65 };
+	input.feed(msb,sizeof(msb));
+	while (receiver.read()) { }
+	TEST_CHECK(test_parameter_count == 5);
+	TEST_CHECK(is_parameter(4,4,1,64 << 7,false));
+	reader.flush();
+	TEST_CHECK(test_parameter_count == 6);
+	TEST_CHECK(is_parameter(5,4,1,65 << 7,false));
+}
+
+static unsigned test_controller14_count = 0;
+static uint16_t test_controller14_values[8];
+
+static void on_controller14(byte inChannel, byte inNumber, uint16_t inValue) {
+	TEST_CHECK(test_controller14_count < 8);
+	test_controller14_values[test_controller14_count++] = inValue;
+	TEST_CHECK(inChannel >= 1 && inChannel <= 3);
+	TEST_CHECK(inNumber == (inChannel == 1 ? 1 : 7));
+}
+
+static void test_controller14() {
+
+	static uint8_t stream[256];
+	HostSerial serial(stream,sizeof(stream));
+	TestMIDI midi(serial);
+	midi.begin(1);
+	MIDI_ControllerCache<TestMIDI,4> cache(midi);
+
+	// The cache only sends the bytes that changed.
+	cache.sendControlChange14(1,1000,1);
+	cache.sendControlChange14(1,1001,1);
+	cache.sendControlChange14(1,1001,1);
+	cache.sendControlChange14(1,2000,1);
+	midi.sendControlChange14(7,16383,2);
+	midi.sendControlChange(7,5,3);
+	midi.sendNoteOn(1,1,3);
+	midi.sendControlChange(2,5,3);
+	static const uint8_t expected[] = { 0xB0,1,7, 33,104, 33,105, 1,15, 33,80, 0xB1,7,127, 39,127, 0xB2,7,5, 0x92,1,1, 0xB2,2,5 };
+	TEST_CHECK(serial.written() == sizeof(expected) && memcmp(stream,expected,sizeof(expected)) == 0);
+
+	// An MSB alone (7 on channel 3) is reported with a null LSB at the next message.
+	HostSerial input(test_output,sizeof(test_output));
+	TestMIDI receiver(input);
+	receiver.begin(MIDI_CHANNEL_OMNI);
+	receiver.turnThruOff();
+	MIDI_Controller14Reader reader;
+	TEST_CHECK(reader.add(1) && reader.add(7));
+	reader.setHandleController14(on_controller14);
+	receiver.setController14Reader(&reader);
+	input.feed(stream,serial.written());
+	while (receiver.read()) { }
+	reader.flush();
+	static const uint16_t values[] = { 1000, 1001, 2000, 16383, 5 << 7 };
+	TEST_CHECK(test_controller14_count == 5);
+	TEST_CHECK(memcmp(test_controller14_values,values,sizeof(values)) == 0);
+}
+
+
+/* ####### Universal MIDI Packets ####### */
+
+// Min-center-max upscaling of the MIDI 2.0 specification, bit by bit.
+static uint32_t scale_reference(uint32_t inValue, unsigned inSourceBits, unsigned inDestinationBits) {
+	const unsigned shift = inDestinationBits - inSourceBits;
+	const uint32_t center = 1UL << (inSourceBits - 1);
+	uint32_t result = inValue << shift;
+	if (inValue <= center) return result;
+	// Above the center: the bits below the MSB are repeated in the low bits.
+	const uint32_t repeat = inValue & (center - 1);
+	const unsigned repeat_bits = inSourceBits - 1;
+	for (int left = (int)shift; left > 0; left -= repeat_bits) {
+		result |= (left >= (int)repeat_bits) ? repeat << (left - repeat_bits) : repeat >> (repeat_bits - left);
+	}
+	return result;
+}
+
+static void test_ump() {
+
+	for (uint32_t v=0;v<128;v++) {
+		TEST_CHECK(MIDI_UMP::scale7to16(v) == scale_reference(v,7,16));
+		TEST_CHECK(MIDI_UMP::scale7to32(v) == scale_reference(v,7,32));
+		TEST_CHECK((MIDI_UMP::scale7to32(v) >> 25) == v);
+	}
+	for (uint32_t v=0;v<16384;v++) {
+		TEST_CHECK(MIDI_UMP::scale14to32(v) == scale_reference(v,14,32));
+		TEST_CHECK((MIDI_UMP::scale14to32(v) >> 18) == v);
+	}
+
+	static const byte sizes[16] = { 1,1,1,2,2,4,1,1,2,2,2,3,3,4,4,4 };
+	for (byte t=0;t<16;t++) TEST_CHECK(MIDI_UMP::getSize(t) == sizes[t]);
+
+	// Channel Voice messages, MIDI 1.0 and MIDI 2.0 packets: converted back to the same message.
+	static const kMIDIType types[] = { NoteOff, NoteOn, AfterTouchPoly, ControlChange, ProgramChange, AfterTouchChannel, PitchBend };
+	MIDI_UMP packet;
+	midimsg<32> message;
+	for (byte midi2=0;midi2<2;midi2++) for (byte t=0;t<7;t++) for (byte channel=1;channel<=16;channel++) {
+		for (byte data1=0;data1<128;data1+=7) for (byte data2=0;data2<128;data2+=9) {
+			TEST_CHECK(packet.fromMessage(types[t],data1,data2,channel,3,midi2 != 0));
+			TEST_CHECK(packet.getGroup() == 3 && packet.getSize() == (midi2 ? 2 : 1));
+			memset(&message,0,sizeof(message));
+			TEST_CHECK(packet.toMessage(message) && message.valid);
+			const kMIDIType type = (midi2 && types[t] == NoteOn && data2 == 0) ? NoteOff : types[t];
+			const byte value = (types[t] == ProgramChange || types[t] == AfterTouchChannel) ? 0 : data2;
+			TEST_CHECK(message.type == type && message.channel == channel && message.data1 == data1 && message.data2 == value);
+		}
+	}
+
+	// System messages: only the data bytes of the type are kept.
+	TEST_CHECK(packet.fromMessage(SongPosition,5,6,0,1,true));
+	TEST_CHECK(packet.toMessage(message) && message.type == SongPosition && message.data1 == 5 && message.data2 == 6);
+	TEST_CHECK(packet.fromMessage(Clock,5,6,0,1,true) && packet.word[0] == 0x11F80000UL);
+	TEST_CHECK(!packet.fromMessage(SystemExclusive,5,6,0,1,true));
+	packet.word[0] = 0x10F30506UL;		// Song Select, with a second data byte
+	TEST_CHECK(packet.toMessage(message) && message.type == SongSelect && message.data1 == 5 && message.data2 == 0);
+	packet.word[0] = 0x10FE0506UL;		// Active Sensing, with data bytes
+	TEST_CHECK(packet.toMessage(message) && message.type == ActiveSensing && message.data1 == 0 && message.data2 == 0);
+	static const byte undefined[] = { 0xF0, 0xF4, 0xF5, 0xF7, 0xF9, 0xFD };
+	for (byte i=0;i<sizeof(undefined);i++) {
+		packet.word[0] = 0x10000000UL | ((uint32_t)undefined[i] << 16);
+		TEST_CHECK(!packet.toMessage(message));
+	}
+
+	// SysEx in 7-bit data packets, truncated to the size of the message.
+	byte data[40];
+	for (byte length=0;length<40;length++) {
+		for (byte i=0;i<length;i++) data[i] = (i * 3) & 0x7F;
+		memset(&message,0,sizeof(message));
+		byte offset = 0;
+		unsigned packets = 0;
+		bool complete = false;
+		do {
+			offset = packet.fromSysEx(data,length,offset,2);
+			packets++;
+			complete = packet.toMessage(message);
+			TEST_CHECK(complete == (offset >= length));
+		} while (offset < length);
+		TEST_CHECK(complete && packets == (length ? (length + 5u) / 6 : 1u));
+		const byte expected = (length + 2 > 32) ? 32 : length + 2;
+		TEST_CHECK(message.data1 == expected);
+		TEST_CHECK(message.sysex_array[0] == 0xF0 && message.sysex_array[expected - 1] == 0xF7);
+		for (byte i=1;i<expected-1;i++) TEST_CHECK(message.sysex_array[i] == data[i - 1]);
+	}
+
+	// Continue packet without a start.
+	memset(&message,0,sizeof(message));
+	packet.word[0] = 0x32200000UL;
+	packet.word[1] = 0;
+	TEST_CHECK(!packet.toMessage(message));
+}
+
+
+/* ####### MPE ####### */
+
+static unsigned test_mpe_notes = 0;
+static void on_mpe_note(byte, const MIDI_MPENote &) { test_mpe_notes++; }
+
+static void test_mpe() {
+
+	static uint8_t stream[4096];
+	HostSerial serial(stream,sizeof(stream));
+	TestMIDI midi(serial);
+	midi.begin(1);
+	MIDI_MPESender<TestMIDI> sender(midi);
+
+	HostSerial input(test_output,sizeof(test_output));
+	TestMIDI receiver(input);
+	receiver.begin(MIDI_CHANNEL_OMNI);
+	receiver.turnThruOff();
+	MIDI_MPEReader reader;
+	reader.setHandleNote(on_mpe_note);
+	receiver.setMPEReader(&reader);
+
+	// Zones configured by the sender's RPNs.
+	sender.configure(MPELowerZone,4,24);
+	sender.configure(MPEUpperZone,3);
+	input.feed(stream,serial.written());
+	while (receiver.read()) { }
+	serial.rewindOutput();
+	TEST_CHECK(reader.getZones().getMembers(MPELowerZone) == 4 && reader.getZones().getMembers(MPEUpperZone) == 3);
+	TEST_CHECK(reader.getBendRange(MPELowerZone) == 24 && reader.getBendRange(MPEUpperZone) == 48);
+
+	// One member channel per note, with its own expression.
+	TEST_CHECK(sender.noteOn(60,100,MPELowerZone) == 2);
+	TEST_CHECK(sender.noteOn(64,100,MPELowerZone) == 3);
+	TEST_CHECK(sender.noteOn(67,100,MPEUpperZone) == 15);
+	sender.pitchBend(60,8192 + 4096,MPELowerZone);
+	sender.pressure(64,90,MPELowerZone);
+	sender.timbre(67,10,MPEUpperZone);
+	midi.sendPitchBend((unsigned int)(8192 + 4096),1);		// Zone wide, on the manager channel
+	input.feed(stream,serial.written());
+	while (receiver.read()) { }
+	serial.rewindOutput();
+	TEST_CHECK(reader.find(60,MPELowerZone) == 2 && reader.find(67,MPEUpperZone) == 15);
+	// Half of the bend ranges: 24 semitones for the members, 2 for the manager. Both add up.
+	TEST_CHECK(reader.getPitch(2) == (60 + 12 + 1) * 256);
+	TEST_CHECK(reader.getPitch(3) == (64 + 1) * 256);
+	TEST_CHECK(reader.getNote(3).pressure == 90 && reader.getNote(15).timbre == 10);
+	TEST_CHECK(test_mpe_notes > 0);
+
+	// Released channels are reused last, then the channels are shared.
+	TEST_CHECK(sender.noteOff(60,0,MPELowerZone) == 2);
+	TEST_CHECK(sender.noteOn(70,1,MPELowerZone) == 4);
+	TEST_CHECK(sender.noteOn(71,1,MPELowerZone) == 5);
+	TEST_CHECK(sender.noteOn(72,1,MPELowerZone) == 2);
+	TEST_CHECK(sender.noteOn(73,1,MPELowerZone) == 2);
+
+	// A lower zone of 14 members removes the upper zone, the held notes are released.
+	sender.configure(MPELowerZone,14);
+	input.feed(stream,serial.written());
+	while (receiver.read()) { }
+	serial.rewindOutput();
+	TEST_CHECK(reader.getZones().getMembers(MPEUpperZone) == 0);
+	for (byte channel=1;channel<=16;channel++) TEST_CHECK(!reader.getNote(channel).on);
+
+	// Random notes: the allocator never fails.
+	bool held[128] = { false };
+	unsigned long seed = 1;
+	for (unsigned i=0;i<20000;i++) {
+		seed = seed * 1103515245UL + 12345;
+		const byte note = (seed >> 16) & 0x7F;
+		if (held[note]) TEST_CHECK(sender.noteOff(note,0,MPELowerZone) != 0);
+		else TEST_CHECK(sender.noteOn(note,1,MPELowerZone) != 0);
+		held[note] = !held[note];
+	}
+}
+
+
+/* ####### Events ####### */
+
+static unsigned test_event_count = 0;
+static midievent test_last_event;
+static void on_event(const midievent & inEvent) { test_event_count++; test_last_event = inEvent; }
+
+static void test_events() {
+
+	TEST_CHECK(sizeof(midievent) == 4);
+	midievent event = makeEvent(NoteOn,60,100,5,3);
+	TEST_CHECK(event.status == 0x94 && event.getType() == NoteOn && event.getChannel() == 5 && event.getPort() == 3);
+	event = makeEvent(Clock,0,0,0);
+	TEST_CHECK(event.status == Clock && event.getType() == Clock && event.getChannel() == 0);
+
+	// Channel messages out of channels 1 to 16 are invalid.
+	TEST_CHECK(makeEvent(NoteOn,60,100,MIDI_CHANNEL_OMNI).status == InvalidType);
+	TEST_CHECK(makeEvent(ControlChange,7,100,MIDI_CHANNEL_OFF).status == InvalidType);
+	TEST_CHECK(makeEvent(PitchBend,0,64,16).status == 0xEF);
+
+	// SysEx bytes stored in their own ring buffer.
+	MIDI_EventQueue<8,20> queue;
+	static const byte sysex[] = { 0xF0,1,2,3,0xF7 };
+	static const byte long_sysex[] = { 0xF0,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,0xF7 };
+	byte array[32];
+	TEST_CHECK(queue.push(makeEvent(NoteOn,1,2,3)));
+	TEST_CHECK(queue.push(makeEvent(SystemExclusive,5,0,0),sysex));
+	TEST_CHECK(!queue.push(makeEvent(SystemExclusive,18,0,0),long_sysex));
+	TEST_CHECK(queue.getDropped() == 1);
+	TEST_CHECK(!queue.push(makeEvent(SystemExclusive,5,0,0)));
+	TEST_CHECK(queue.pop(event) && event.getType() == NoteOn);
+	TEST_CHECK(queue.pop(event,array) && event.getType() == SystemExclusive && event.data1 == 5 && memcmp(array,sysex,5) == 0);
+	TEST_CHECK(queue.push(makeEvent(SystemExclusive,18,0,0),long_sysex));		// Wraps around
+	TEST_CHECK(queue.pop(event,array) && memcmp(array,long_sysex,18) == 0);
+	TEST_CHECK(queue.isEmpty());
+	for (byte i=0;i<8;i++) TEST_CHECK(queue.push(makeEvent(ControlChange,i,i,1)));
+	TEST_CHECK(queue.isFull() && !queue.push(makeEvent(Clock,0,0,0)));
+	for (byte i=0;i<8;i++) TEST_CHECK(queue.pop(event) && event.data1 == i);
+
+	// Received, queued, then forwarded.
+	static uint8_t stream[64];
+	HostSerial serial(stream,sizeof(stream));
+	TestMIDI midi(serial);
+	midi.begin(1);
+	midi.sendNoteOn(60,100,2);
+	midi.sendSysEx(3,(byte *)sysex + 1);
+	midi.sendRealTime(Clock);
+	midi.sendSongPosition(300);
+	const unsigned long length = serial.written();
+
+	HostSerial input(test_output,sizeof(test_output));
+	TestMIDI receiver(input);
+	receiver.begin(MIDI_CHANNEL_OMNI);
+	receiver.turnThruOff();
+	receiver.setHandleEvent(on_event);
+	input.feed(stream,length);
+	while (receiver.read()) TEST_CHECK(queue.push(receiver.getMessage()));
+	TEST_CHECK(test_event_count == 4 && test_last_event.getType() == SongPosition);
+
+	static uint8_t received[64];
+	memcpy(received,stream,length);
+	serial.rewindOutput();
+	while (queue.pop(event,array)) midi.forward(event,array);
+	TEST_CHECK(serial.written() == length && memcmp(stream,received,length) == 0);
+
+	// Scheduled events: not the SysEx, nor the invalid channels.
+	serial.rewindOutput();
+	MIDI_Scheduler<TestMIDI> scheduler(midi);
+	TEST_CHECK(scheduler.schedule(10,makeEvent(NoteOn,1,2,3)));
+	TEST_CHECK(scheduler.schedule(5,Start,0,0,0));
+	TEST_CHECK(!scheduler.schedule(5,makeEvent(SystemExclusive,3,0,0)));
+	TEST_CHECK(!scheduler.schedule(5,NoteOn,60,100,MIDI_CHANNEL_OMNI));
+	TEST_CHECK(!scheduler.schedule(5,NoteOff,60,0,MIDI_CHANNEL_OFF));
+	scheduler.dispatch(20);
+	static const uint8_t dispatched[] = { Start, 0x92,1,2 };
+	TEST_CHECK(serial.written() == sizeof(dispatched) && memcmp(stream,dispatched,sizeof(dispatched)) == 0);
+}
+
+
+int main() {
+
+	test_router();
+	test_merger();
+	test_running_status_refresh();
+	test_note_off_as_note_on();
+	test_active_sensing();
+	test_clock_master();
+	test_clock_follower();
+	test_time_code();
+	test_file_player();
+	test_file_recorder();
+	test_note_tracker();
+	test_controller_cache();
+	test_parameters_rpn();
+	test_controller14();
+	test_ump();
+	test_mpe();
+	test_events();
+
+	printf("All checks passed.\n");
+	return 0;
+}
@@ -0,0 +1,332 @@
+/*!
+ *  @file		MIDI_Clock.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - MIDI Clock generation and synchronisation
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_CLOCK_H_
+#define LIB_MIDI_CLOCK_H_
+
+#include "MIDI_Defs.h"
+#include "MIDI_Time.h"
+
+
+/*! Number of MIDI Clocks per quarter note. */
+#define MIDI_CLOCKS_PER_BEAT		24
+
+/*! Number of MIDI Clocks per MIDI beat (a sixteenth note, the Song Position unit). */
+#define MIDI_CLOCKS_PER_MIDI_BEAT	6
+
+
+/*! \brief MIDI Clock master: sends the Clock at a given tempo, and the Start/Stop/Continue/Song Position messages.
+
+ The time is given to tick(), by a timer interrupt with its period, or by
+ update() in loop(). The Clock period is rarely a whole number of
+ microseconds, so the elapsed time is accumulated exactly (in microseconds x
+ hundredths of BPM): the tempo has no drift, only the jitter of the caller.
+ \code
+ MIDI_ClockMaster<MIDI_Class> clock(MIDI);
+
+ ISR(TIMER2_COMPA_vect) { clock.tick(250); }		// Timer at 4 kHz, see MIDI_Scheduler for the setup.
+
+ void setup() {
+ 	MIDI.begin();
+ 	clock.setTempo(12000);							// 120.00 BPM
+ 	clock.start();
+ }
+ \endcode
+ The Clock bytes are sent with sendRealTime(). When tick() runs in an
+ interrupt, the program must not send anything else on the same interface
+ (nor the Thru): the serial port is not reentrant, an interrupted write would
+ corrupt its buffer. Send the other messages from the same interrupt, eg:
+ through a MIDI_Scheduler dispatched by it, or use update() in loop().
+ */
+template<class Interface>
+class MIDI_ClockMaster {
+
+public:
+
+	MIDI_ClockMaster(Interface & inInterface) : mInterface(inInterface), mTempo(12000), mAccumulator(0), mRunning(false), mClocks(0), mSongPosition(0), mLastUpdate(0), mUpdated(false) { }
+
+	/*! \brief Set the tempo, in hundredths of BPM (eg: 12000 for 120 BPM), from 1.00 to 655.35 BPM. */
+	void setTempo(uint16_t inTempo) {
+		if (inTempo == 0) inTempo = 1;
+		MIDI_ATOMIC_BEGIN
+		mTempo = inTempo;
+		MIDI_ATOMIC_END
+	}
+
+	uint16_t getTempo() const { return mTempo; }
+
+	/*! \brief Start from the beginning of the song. */
+	void start() {
+		MIDI_ATOMIC_BEGIN
+		mSongPosition = 0;
+		mClocks = 0;
+		mAccumulator = 0;
+		mRunning = true;
+		mInterface.sendRealTime(Start);
+		MIDI_ATOMIC_END
+		mLastUpdate = MIDI_MICROS();
+	}
+
+	void stop() {
+		MIDI_ATOMIC_BEGIN
+		mRunning = false;
+		mInterface.sendRealTime(Stop);
+		MIDI_ATOMIC_END
+	}
+
+	/*! \brief Continue from the current song position. */
+	void resume() {
+		MIDI_ATOMIC_BEGIN
+		mAccumulator = 0;
+		mRunning = true;
+		mInterface.sendRealTime(Continue);
+		MIDI_ATOMIC_END
+		mLastUpdate = MIDI_MICROS();
+	}
+
+	/*! \brief Move to a song position (in MIDI beats, sixteenth notes) and send it. Ignored while running, as the MIDI spec requires. */
+	void setSongPosition(unsigned int inBeats) {
+		if (mRunning) return;
+		MIDI_ATOMIC_BEGIN
+		mSongPosition = inBeats;
+		mClocks = 0;
+		MIDI_ATOMIC_END
+		mInterface.sendSongPosition(inBeats);
+	}
+
+	/*! \brief Current song position, in MIDI beats (sixteenth notes). */
+	unsigned int getSongPosition() const { return mSongPosition; }
+
+	bool isRunning() const { return mRunning; }
+
+	/*! \brief Advance the time by inElapsed microseconds, and send the Clocks that are due.
+
+	 Call it from a timer interrupt with the timer period, or use update().
+	 The Clock is sent when stopped too (the receivers keep their tempo),
+	 only the song position is frozen.
+	 */
+	void tick(uint16_t inElapsed) {
+
+		// inElapsed x tempo can reach 2^32: added in two halves, each below 2^31.
+		const uint16_t half = inElapsed >> 1;
+		advance(half);
+		advance(inElapsed - half);
+	}
+
+	/*! \brief Send the Clocks that are due since the last call, using MIDI_MICROS(). Call it in loop(), if tick() is not called by a timer.
+
+	 The time counts from the first call, and from start() and resume().
+	 */
+	void update() {
+		const unsigned long now = MIDI_MICROS();
+		unsigned long elapsed = mUpdated ? now - mLastUpdate : 0;
+		mLastUpdate = now;
+		mUpdated = true;
+		while (elapsed > 0xFFFF) {
+			tick(0xFFFF);
+			elapsed -= 0xFFFF;
+		}
+		tick((uint16_t)elapsed);
+	}
+
+private:
+
+	void advance(uint16_t inElapsed) {
+
+		// Clock period: 60e6 / (24 * BPM) us = 250e6 / (tempo in hundredths of BPM) us.
+		// The accumulator stays below 250e6, so it can't overflow.
+		mAccumulator += (uint32_t)inElapsed * mTempo;
+
+		while (mAccumulator >= 250000000UL) {
+			mAccumulator -= 250000000UL;
+			mInterface.sendRealTime(Clock);
+			if (mRunning && ++mClocks >= MIDI_CLOCKS_PER_MIDI_BEAT) {
+				mClocks = 0;
+				mSongPosition++;
+			}
+		}
+	}
+
+	Interface &				mInterface;
+
+	volatile uint16_t		mTempo;
+	volatile uint32_t		mAccumulator;
+	volatile bool			mRunning;
+	volatile byte			mClocks;		// Clocks since the last MIDI beat
+	volatile unsigned int	mSongPosition;
+	unsigned long			mLastUpdate;
+	bool					mUpdated;		// update() was called, mLastUpdate is valid
+
+};
+
+
+/*! \brief MIDI Clock follower: estimates the tempo and the position of an external MIDI Clock.
+
+ Attach it to the interface receiving the Clock: the Clock bytes are then
+ timestamped (MIDI_MICROS()) as soon as read() parses them, and Start, Stop,
+ Continue and Song Position update the position. The time of the next Clocks
+ is predicted by a phase locked loop (alpha-beta filter: the phase follows
+ 1/4 of the error, the period 1/32), which smooths the jitter of the sender,
+ of the transport (USB) and of loop().
+ \code
+ MIDI_ClockFollower follower;
+
+ void setup() {
+ 	MIDI.begin();
+ 	MIDI.setClockFollower(&follower);
+ }
+
+ void loop() {
+ 	MIDI.read();
+ 	if (follower.isLocked()) {
+ 		// Tempo: follower.getTempo() / 100.0 BPM
+ 		// Time of the next beat, to schedule a note on it:
+ 		const unsigned long beat = (follower.getClockPosition() / MIDI_CLOCKS_PER_BEAT + 1) * MIDI_CLOCKS_PER_BEAT;
+ 		const unsigned long time = follower.getTimeOfClock(beat);
+ 		...
+ 	}
+ }
+ \endcode
+ Times are in MIDI_MICROS() units: the same as MIDI_Scheduler.
+ */
+class MIDI_ClockFollower {
+
+public:
+
+	MIDI_ClockFollower() { reset(); }
+
+	/*! \brief Forget the tempo and the position (eg: when the Clock source changes). */
+	void reset() {
+		mCount = 0;
+		mPhase = 0;
+		mPeriod = 0;
+		mRunning = false;
+		mPosition = 0;
+		mNextPosition = 0;
+	}
+
+	/*! \brief Called by MIDI_Interface::read() with the received messages, and their time. */
+	void received(kMIDIType inType, byte inData1, byte inData2, unsigned long inTime) {
+
+		switch (inType) {
+			case Clock:
+				clock(inTime);
+				break;
+			case Start:
+				mNextPosition = 0;
+				mRunning = true;
+				break;
+			case Continue:
+				mRunning = true;
+				break;
+			case Stop:
+				mRunning = false;
+				break;
+			case SongPosition:
+				// Only valid when stopped, the position of the next Clock after Continue.
+				if (!mRunning) mNextPosition = (unsigned long)((inData2 << 7) | inData1) * MIDI_CLOCKS_PER_MIDI_BEAT;
+				break;
+			default:
+				break;
+		}
+	}
+
+	/*! \brief Process a Clock received at inTime, when the follower is fed without MIDI_Interface::setClockFollower(). */
+	void clock(unsigned long inTime) {
+
+		if (mRunning) mPosition = mNextPosition++;
+
+		if (mCount == 0) {
+			mPhase = inTime;
+			mCount = 1;
+			return;
+		}
+
+		const unsigned long interval = inTime - mPhase;
+
+		// Same time as the last Clock (coarse or missing time source): not a period.
+		if (interval == 0) return;
+
+		// Second Clock, or Clock stopped for a while (or way off): measure the period again.
+		if (mCount == 1 || interval > (mPeriod >> (PeriodShift - 2)) || interval < (mPeriod >> (PeriodShift + 1))) {
+			mPeriod = interval << PeriodShift;
+			mPhase = inTime;
+			mCount = 2;
+			return;
+		}
+
+		// Phase error against the predicted time of this Clock.
+		const unsigned long predicted = mPhase + (mPeriod >> PeriodShift);
+		const long error = (long)(inTime - predicted);
+
+		mPhase = predicted + error / 4;
+		mPeriod += error / (32 >> PeriodShift);
+		if (mCount < LockCount) mCount++;
+	}
+
+	/*! \brief True when the tempo estimate is settled (a beat of regular Clock was received). */
+	bool isLocked() const { return mCount >= LockCount; }
+
+	/*! \brief True between Start/Continue and Stop. */
+	bool isRunning() const { return mRunning; }
+
+	/*! \brief Estimated tempo, in hundredths of BPM (as MIDI_ClockMaster::setTempo()), 0 if unknown. */
+	uint16_t getTempo() const {
+		if (mCount < 2 || mPeriod == 0) return 0;
+		// 250e6 / period in us, the period is in 1/16 us.
+		const unsigned long tempo = 4000000000UL / mPeriod;
+		return (tempo > 0xFFFF) ? 0xFFFF : (uint16_t)tempo;
+	}
+
+	/*! \brief Estimated Clock period, in microseconds. */
+	unsigned long getClockPeriod() const { return mPeriod >> PeriodShift; }
+
+	/*! \brief Position of the last Clock since the start of the song, in Clocks (24 per quarter note). */
+	unsigned long getClockPosition() const { return mPosition; }
+
+	/*! \brief Song position of the last Clock, in MIDI beats (sixteenth notes). */
+	unsigned int getSongPosition() const { return mPosition / MIDI_CLOCKS_PER_MIDI_BEAT; }
+
+	/*! \brief Position at a given time, in 1/256 of quarter notes, extrapolated from the last Clock (at most one Clock ahead). */
+	unsigned long getBeatPosition(unsigned long inTime) const {
+		unsigned long fraction = 0;		// In 1/256 Clock
+		if (mPeriod != 0 && (long)(inTime - mPhase) > 0) {
+			const unsigned long elapsed = inTime - mPhase;
+			fraction = (elapsed < (mPeriod >> PeriodShift)) ? ((elapsed << 8) / (mPeriod >> PeriodShift)) : 255;
+		}
+		return (mPosition * 256 + fraction) / MIDI_CLOCKS_PER_BEAT;
+	}
+
+	/*! \brief Predicted time of a Clock position (see getClockPosition()), to schedule events ahead. */
+	unsigned long getTimeOfClock(unsigned long inPosition) const {
+		const long clocks = (long)(inPosition - mPosition);
+		const long period = (long)mPeriod;
+		return mPhase + clocks * (period >> PeriodShift) + clocks * (period & ((1 << PeriodShift) - 1)) / (1 << PeriodShift);
+	}
+
+private:
+
+	enum {
+		PeriodShift = 4,				// The period is stored in 1/16 us.
+		LockCount = MIDI_CLOCKS_PER_BEAT
+	};
+
+	byte			mCount;				// Clocks received since the last reset/resync, up to LockCount.
+	unsigned long	mPhase;				// Estimated time of the last Clock
+	unsigned long	mPeriod;			// Estimated Clock period, in 1/16 us
+
+	bool			mRunning;
+	unsigned long	mPosition;			// Position of the last Clock
+	unsigned long	mNextPosition;		// Position of the next Clock
+
+};
+
+
+#endif // LIB_MIDI_CLOCK_H_
@@ -0,0 +1,516 @@
+/*!
+ *  @file		MIDI_Controllers.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Controllers: output cache, RPN, NRPN and 14-bit controllers
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_CONTROLLERS_H_
+#define LIB_MIDI_CONTROLLERS_H_
+
+#include "MIDI_Defs.h"
+#include "MIDI_Time.h"
+
+
+/*
+    ###############################################################
+    #                                                             #
+    #    14-BIT CONTROLLERS                                       #
+    #                                                             #
+    #    Maximum number of 14-bit controllers of a                #
+    #    MIDI_Controller14Reader (19 bytes of RAM each). Define   #
+    #    it before including the library to change it.           #
+    #                                                             #
+    ###############################################################
+ */
+
+#ifndef MIDI_CONTROLLER14_PAIRS
+#define MIDI_CONTROLLER14_PAIRS		4
+#endif
+
+
+/*! \brief Output cache of the controllers: sends Control Change, Pitch Bend and After Touch only when their value changes.
+
+ Each controller (type, channel and number) sent through the cache uses a
+ slot, up to Slots (11 bytes each on AVR, 12 on 32-bit cores): when they
+ are all used, the other controllers are sent without filtering. A value is
+ not sent if it is the same as the last one sent, or within the deadband
+ (setDeadband(), for noisy pots: the extreme values are always sent). With
+ setMinInterval(), a controller is not sent more often than the interval:
+ the last value is kept, and sent by update() when the interval is over.
+ \code
+ MIDI_ControllerCache<MIDI_Class,8> controls(MIDI);
+
+ void setup() {
+ 	MIDI.begin();
+ 	controls.setDeadband(1);
+ 	controls.setMinInterval(10);		// 100 messages/s per controller, at most.
+ }
+
+ void loop() {
+ 	for (byte i=0;i<8;i++) controls.sendControlChange(20 + i,analogRead(i) >> 3,1);
+ 	controls.update();
+ }
+ \endcode
+ */
+template<class Interface, byte Slots = 16>
+class MIDI_ControllerCache {
+
+public:
+
+	MIDI_ControllerCache(Interface & inInterface) : mInterface(inInterface), mNumSlots(0), mDeadband(0), mMinInterval(0) { }
+
+	/*! \brief Don't send the changes smaller or equal to inDeadband (in 7-bit steps, also for Pitch Bend). 0 by default. */
+	void setDeadband(byte inDeadband) { mDeadband = inDeadband; }
+
+	/*! \brief Minimum time between two messages of a controller, in ms. 0 (no limit) by default. */
+	void setMinInterval(uint16_t inMillis) { mMinInterval = inMillis; }
+
+	void sendControlChange(byte inNumber, byte inValue, byte inChannel) { send(ControlChange,inNumber & 0x7F,inValue & 0x7F,inChannel); }
+	/*! \brief 14-bit Control Change (inNumber 0 to 31, and inNumber + 32): the MSB is sent only when it changes. */
+	void sendControlChange14(byte inNumber, uint16_t inValue, byte inChannel) { send(ControlChange,(inNumber & 0x1F) | Controller14,inValue & 0x3FFF,inChannel); }
+	void sendPitchBend(int inValue, byte inChannel) { send(PitchBend,0,inValue + 8192,inChannel); }
+	void sendAfterTouch(byte inPressure, byte inChannel) { send(AfterTouchChannel,0,inPressure & 0x7F,inChannel); }
+	void sendPolyPressure(byte inNote, byte inPressure, byte inChannel) { send(AfterTouchPoly,inNote & 0x7F,inPressure & 0x7F,inChannel); }
+
+	/*! \brief Send the values held by the rate limiter, when their interval is over. Call it in loop(). */
+	void update() {
+		if (mMinInterval == 0) return;
+		const uint16_t now = MIDI_MILLIS();
+		for (byte i=0;i<mNumSlots;i++) {
+			Slot & slot = mSlots[i];
+			if (slot.pending && (uint16_t)(now - slot.time) >= mMinInterval) transmit(slot,slot.next,now);
+		}
+	}
+
+	/*! \brief Forget the values sent: the next values will be sent, changed or not (eg: when a device is plugged in). */
+	void clear() { mNumSlots = 0; }
+
+private:
+
+	enum { Controller14 = 0x80 };	// Bit of the number of the 14-bit controllers
+
+	struct Slot {
+		byte		type;
+		byte		channel;
+		byte		number;		// | Controller14 for the 14-bit controllers
+		bool		pending;	// next is waiting for the end of the interval.
+		bool		sent;		// value is valid
+		uint16_t	value;		// Last value sent
+		uint16_t	next;
+		uint16_t	time;		// Time of the last message sent
+	};
+
+	void send(kMIDIType inType, byte inNumber, uint16_t inValue, byte inChannel) {
+
+		if (inType == PitchBend && inValue > 16383) inValue = (inValue & 0x8000) ? 0 : 16383;
+
+		Slot * slot = find(inType,inNumber,inChannel);
+		const uint16_t now = MIDI_MILLIS();
+
+		if (slot == NULL) {
+			if (mNumSlots >= Slots) {
+				write(inType,inNumber,inValue,inChannel);	// No room: not filtered.
+				return;
+			}
+			slot = &mSlots[mNumSlots++];
+			slot->type = inType;
+			slot->channel = inChannel;
+			slot->number = inNumber;
+			slot->sent = false;
+			transmit(*slot,inValue,now);
+			return;
+		}
+
+		// Changed enough?
+		const bool wide = (inType == PitchBend) || (inNumber & Controller14);
+		const uint16_t max = wide ? 16383 : 127;
+		const uint16_t deadband = wide ? ((uint16_t)mDeadband << 7) : mDeadband;
+		const uint16_t change = (inValue > slot->value) ? inValue - slot->value : slot->value - inValue;
+		if (change == 0 || (change <= deadband && inValue != 0 && inValue != max)) {
+			slot->pending = false;		// Back to the value sent.
+			return;
+		}
+
+		if (mMinInterval != 0 && (uint16_t)(now - slot->time) < mMinInterval) {
+			slot->next = inValue;
+			slot->pending = true;
+			return;
+		}
+
+		transmit(*slot,inValue,now);
+	}
+
+	void transmit(Slot & ioSlot, uint16_t inValue, uint16_t inNow) {
+		if (ioSlot.number & Controller14) {
+			// 14-bit controller: the LSB alone updates the value when the MSB is unchanged.
+			const byte number = ioSlot.number & 0x1F;
+			if (!ioSlot.sent || (ioSlot.value >> 7) != (inValue >> 7)) mInterface.send(ControlChange,number,inValue >> 7,ioSlot.channel);
+			mInterface.send(ControlChange,number + 32,inValue & 0x7F,ioSlot.channel);
+		}
+		else write((kMIDIType)ioSlot.type,ioSlot.number,inValue,ioSlot.channel);
+		ioSlot.value = inValue;
+		ioSlot.time = inNow;
+		ioSlot.pending = false;
+		ioSlot.sent = true;
+	}
+
+	void write(kMIDIType inType, byte inNumber, uint16_t inValue, byte inChannel) {
+		if (inNumber & Controller14) {
+			mInterface.sendControlChange14(inNumber & 0x1F,inValue,inChannel);
+			return;
+		}
+		switch (inType) {
+			case PitchBend:			mInterface.send(PitchBend,inValue & 0x7F,inValue >> 7,inChannel); break;
+			case AfterTouchChannel:	mInterface.send(AfterTouchChannel,inValue,0,inChannel); break;
+			default:				mInterface.send(inType,inNumber,inValue,inChannel); break;
+		}
+	}
+
+	Slot * find(byte inType, byte inNumber, byte inChannel) {
+		for (byte i=0;i<mNumSlots;i++) {
+			Slot & slot = mSlots[i];
+			if (slot.type == inType && slot.number == inNumber && slot.channel == inChannel) return &slot;
+		}
+		return NULL;
+	}
+
+	Interface &		mInterface;
+
+	Slot			mSlots[Slots];
+	byte			mNumSlots;
+
+	byte			mDeadband;
+	uint16_t		mMinInterval;
+
+};
+
+
+/*! \brief RPN and NRPN reader: assembles the parameter number and data entry Control Changes into parameter events.
+
+ Attach it to an interface with setParameterReader(), or feed it with
+ process(). The callback is called once per value: when the Data Entry LSB
+ (CC 38) follows the MSB (CC 6), when the MSB is alone (another message
+ arrives on the channel, or flush() is called) with the LSB at 0, or when
+ the LSB is alone, with the last MSB of the parameter.
+ \code
+ MIDI_ParameterReader parameters;
+
+ void handleParameter(byte channel, uint16_t number, uint16_t value, bool nrpn) {
+ 	if (!nrpn && number == 0) bendRange = value >> 7;		// Pitch Bend Sensitivity, in semitones
+ }
+
+ void setup() {
+ 	MIDI.begin();
+ 	MIDI.setParameterReader(&parameters);
+ 	parameters.setHandleParameter(handleParameter);
+ }
+ \endcode
+ The RPN Null (127/127) deselects the parameter. Data Increment and Decrement
+ (CC 96 and 97) are not handled.
+ */
+class MIDI_ParameterReader {
+
+public:
+
+	MIDI_ParameterReader() : mParameterCallback(NULL) { reset(); }
+
+	/*! \brief Forget the parameters selected on all the channels. */
+	void reset() {
+		for (byte c=0;c<16;c++) {
+			mChannels[c].number = NoParameter;
+			mChannels[c].msb = NoValue;
+			mChannels[c].pending = false;
+		}
+	}
+
+	/*! \brief Called with the channel (1 to 16), the parameter number (14 bits), the value (14 bits) and the kind (RPN or NRPN). */
+	void setHandleParameter(void (*fptr)(byte channel, uint16_t number, uint16_t value, bool nrpn)) { mParameterCallback = fptr; }
+
+	/*! \brief Process a received message. */
+	void process(kMIDIType inType, byte inData1, byte inData2, byte inChannel) {
+
+		if (inType >= SystemExclusive || inChannel < 1 || inChannel > 16) return;
+
+		State & state = mChannels[inChannel - 1];
+
+		// Data Entry LSB: completes the MSB received before, or changes the value alone.
+		if (inType == ControlChange && inData1 == 38) {
+			if (state.number != NoParameter && state.msb != NoValue) emit(inChannel,state,inData2);
+			return;
+		}
+
+		// Any other message of the channel ends the value without LSB.
+		if (state.pending) emit(inChannel,state,0);
+
+		if (inType != ControlChange) return;
+
+		switch (inData1) {
+			case 6:		// Data Entry MSB
+				if (state.number != NoParameter) {
+					state.msb = inData2;
+					state.pending = true;
+				}
+				break;
+			case 99:	// NRPN MSB
+			case 101:	// RPN MSB
+				state.msb = NoValue;
+				state.number = (inData1 == 99 ? NRPN : 0) | ((uint16_t)inData2 << 7) | (state.number & 0x7F);
+				break;
+			case 98:	// NRPN LSB
+			case 100:	// RPN LSB
+				state.msb = NoValue;
+				state.number = (inData1 == 98 ? NRPN : 0) | (state.number & 0x3F80) | inData2;
+				break;
+			default:
+				return;
+		}
+
+		// RPN Null: no parameter selected.
+		if ((state.number & 0x3FFF) == 0x3FFF) state.number = NoParameter;
+	}
+
+	/*! \brief Call the callback for the values waiting for their LSB. */
+	void flush() {
+		for (byte c=0;c<16;c++) {
+			if (mChannels[c].pending) emit(c + 1,mChannels[c],0);
+		}
+	}
+
+	/*! \brief Called by MIDI_Interface::read() with the received messages. */
+	void received(kMIDIType inType, byte inData1, byte inData2, byte inChannel) { process(inType,inData1,inData2,inChannel); }
+
+private:
+
+	enum {
+		NRPN = 0x4000,			// Bit of the parameter number for NRPN
+		NoParameter = 0xFFFF,
+		NoValue = 0xFF
+	};
+
+	struct State {
+		uint16_t	number;		// Parameter selected (14 bits, | NRPN), NoParameter if none.
+		byte		msb;		// Last Data Entry MSB of the parameter, NoValue if none.
+		bool		pending;	// The MSB is waiting for its LSB.
+	};
+
+	void emit(byte inChannel, State & ioState, byte inLSB) {
+		ioState.pending = false;
+		if (mParameterCallback != NULL) {
+			mParameterCallback(inChannel,ioState.number & 0x3FFF,((uint16_t)ioState.msb << 7) | inLSB,(ioState.number & NRPN) != 0);
+		}
+	}
+
+	State	mChannels[16];
+
+	void (*mParameterCallback)(byte channel, uint16_t number, uint16_t value, bool nrpn);
+
+};
+
+
+/*! \brief RPN and NRPN sender: sends the parameter number only when it changes, and the Data Entry MSB only when it changes.
+
+ Updating the same parameter again takes 3 bytes (LSB only) to 6 bytes
+ (MSB and LSB) instead of 12, less with running status.
+ \code
+ MIDI_ParameterWriter<MIDI_Class> parameters(MIDI);
+ parameters.sendRPN(0,12 << 7,1);		// Pitch Bend Sensitivity: 12 semitones, channel 1
+ \endcode
+ The receiver keeps the parameter selected: send the RPN Null with end() when
+ done, if other programs use the Data Entry of the channel. Call reset() if
+ the parameter numbers or Data Entry were sent without this object.
+ */
+template<class Interface>
+class MIDI_ParameterWriter {
+
+public:
+
+	MIDI_ParameterWriter(Interface & inInterface) : mInterface(inInterface) { reset(); }
+
+	/*! \brief Forget what was sent: the next values will be sent in full. */
+	void reset() {
+		for (byte c=0;c<16;c++) {
+			mChannels[c].number = NoParameter;
+			mChannels[c].msb = NoValue;
+		}
+	}
+
+	/*! \brief Send a Registered Parameter value (number and value on 14 bits) on a channel (1 to 16). */
+	void sendRPN(uint16_t inNumber, uint16_t inValue, byte inChannel) { send(inNumber & 0x3FFF,inValue,inChannel); }
+
+	/*! \brief Send a Non-Registered Parameter value (number and value on 14 bits) on a channel (1 to 16). */
+	void sendNRPN(uint16_t inNumber, uint16_t inValue, byte inChannel) { send((inNumber & 0x3FFF) | NRPN,inValue,inChannel); }
+
+	/*! \brief Send the RPN Null on a channel (1 to 16): no parameter selected. */
+	void end(byte inChannel) {
+		if (inChannel < 1 || inChannel > 16) return;
+		mInterface.sendControlChange(101,127,inChannel);
+		mInterface.sendControlChange(100,127,inChannel);
+		mChannels[inChannel - 1].number = NoParameter;
+		mChannels[inChannel - 1].msb = NoValue;
+	}
+
+private:
+
+	enum {
+		NRPN = 0x4000,
+		NoParameter = 0xFFFF,
+		NoValue = 0xFF
+	};
+
+	struct State {
+		uint16_t	number;		// Parameter selected, NoParameter if unknown
+		byte		msb;		// Data Entry MSB sent, NoValue if unknown
+	};
+
+	void send(uint16_t inNumber, uint16_t inValue, byte inChannel) {
+
+		if (inChannel < 1 || inChannel > 16) return;
+
+		State & state = mChannels[inChannel - 1];
+		const byte msb = (inValue >> 7) & 0x7F;
+
+		if (state.number != inNumber) {
+			const bool nrpn = (inNumber & NRPN) != 0;
+			mInterface.sendControlChange(nrpn ? 99 : 101,(inNumber >> 7) & 0x7F,inChannel);
+			mInterface.sendControlChange(nrpn ? 98 : 100,inNumber & 0x7F,inChannel);
+			state.number = inNumber;
+			state.msb = NoValue;
+		}
+
+		if (state.msb != msb) {
+			mInterface.sendControlChange(6,msb,inChannel);
+			state.msb = msb;
+		}
+		mInterface.sendControlChange(38,inValue & 0x7F,inChannel);
+	}
+
+	Interface &		mInterface;
+	State			mChannels[16];
+
+};
+
+
+/*! \brief 14-bit Control Change reader: assembles the MSB (0 to 31) and LSB (32 to 63) of the registered controllers.
+
+ Attach it to an interface with setController14Reader(), or feed it with
+ process(), and register the controllers with add() (up to
+ MIDI_CONTROLLER14_PAIRS). The callback is called once per value, as
+ MIDI_ParameterReader: when the LSB follows the MSB, when the MSB is alone
+ (another message arrives on the channel, or flush() is called) with the LSB
+ at 0, or when the LSB is alone, with the last MSB.
+ \code
+ MIDI_Controller14Reader controllers;
+
+ void handleController(byte channel, byte number, uint16_t value) { ... }
+
+ void setup() {
+ 	MIDI.begin();
+ 	MIDI.setController14Reader(&controllers);
+ 	controllers.add(1);			// Modulation wheel (CC 1 and 33)
+ 	controllers.add(7);			// Volume (CC 7 and 39)
+ 	controllers.setHandleController14(handleController);
+ }
+ \endcode
+ The Control Change callback is still called for each of them.
+ */
+class MIDI_Controller14Reader {
+
+public:
+
+	MIDI_Controller14Reader() : mNumPairs(0), mController14Callback(NULL) { }
+
+	/*! \brief Register a 14-bit controller, by the number of its MSB (0 to 31). Returns false if there are already MIDI_CONTROLLER14_PAIRS. */
+	bool add(byte inNumber) {
+		if (inNumber > 31) return false;
+		if (find(inNumber) != NULL) return true;
+		if (mNumPairs >= MIDI_CONTROLLER14_PAIRS) return false;
+		Pair & pair = mPairs[mNumPairs++];
+		pair.number = inNumber;
+		pair.pending = 0;
+		for (byte c=0;c<16;c++) pair.msb[c] = NoValue;
+		return true;
+	}
+
+	/*! \brief Unregister all the controllers. */
+	void clear() { mNumPairs = 0; }
+
+	/*! \brief Called with the channel (1 to 16), the number of the MSB (0 to 31) and the value (14 bits). */
+	void setHandleController14(void (*fptr)(byte channel, byte number, uint16_t value)) { mController14Callback = fptr; }
+
+	/*! \brief Process a received message. */
+	void process(kMIDIType inType, byte inData1, byte inData2, byte inChannel) {
+
+		if (inType >= SystemExclusive || inChannel < 1 || inChannel > 16) return;
+
+		const byte c = inChannel - 1;
+		const uint16_t bit = 1U << c;
+
+		Pair * pair = NULL;
+		if (inType == ControlChange && inData1 < 64) pair = find(inData1 & 0x1F);
+
+		// LSB: completes the MSB, or changes the value alone.
+		if (pair != NULL && inData1 >= 32) {
+			if (pair->msb[c] != NoValue) emit(inChannel,*pair,inData2);
+			return;
+		}
+
+		// Any other message of the channel ends the values without LSB.
+		for (byte i=0;i<mNumPairs;i++) {
+			if (mPairs[i].pending & bit) emit(inChannel,mPairs[i],0);
+		}
+
+		if (pair != NULL) {
+			pair->msb[c] = inData2;
+			pair->pending |= bit;
+		}
+	}
+
+	/*! \brief Call the callback for the values waiting for their LSB. */
+	void flush() {
+		for (byte i=0;i<mNumPairs;i++) {
+			for (byte c=0;c<16;c++) {
+				if (mPairs[i].pending & (1U << c)) emit(c + 1,mPairs[i],0);
+			}
+		}
+	}
+
+	/*! \brief Called by MIDI_Interface::read() with the received messages. */
+	void received(kMIDIType inType, byte inData1, byte inData2, byte inChannel) { process(inType,inData1,inData2,inChannel); }
+
+private:
+
+	enum { NoValue = 0xFF };
+
+	struct Pair {
+		byte		number;		// Number of the MSB
+		byte		msb[16];	// Last MSB of each channel, NoValue if none.
+		uint16_t	pending;	// Channels whose MSB is waiting for its LSB
+	};
+
+	Pair * find(byte inNumber) {
+		for (byte i=0;i<mNumPairs;i++) {
+			if (mPairs[i].number == inNumber) return &mPairs[i];
+		}
+		return NULL;
+	}
+
+	void emit(byte inChannel, Pair & ioPair, byte inLSB) {
+		ioPair.pending &= ~(1U << (inChannel - 1));
+		if (mController14Callback != NULL) {
+			mController14Callback(inChannel,ioPair.number,((uint16_t)ioPair.msb[inChannel - 1] << 7) | inLSB);
+		}
+	}
+
+	Pair	mPairs[MIDI_CONTROLLER14_PAIRS];
+	byte	mNumPairs;
+
+	void (*mController14Callback)(byte channel, byte number, uint16_t value);
+
+};
+
+
+#endif // LIB_MIDI_CONTROLLERS_H_
@@ -0,0 +1,337 @@
+/*!
+ *  @file		MIDI_Core.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Platform independent core
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ *
+ *  This header holds the implementation shared by every platform (Arduino,
+ *  Teensy UART & USB, avr_core). Each platform only instantiates
+ *  MIDI_Interface with its own serial port type, see the platform MIDI.h files.
+ */
+
+#ifndef LIB_MIDI_CORE_H_
+#define LIB_MIDI_CORE_H_
+
+#include "MIDI_Defs.h"
+#include "MIDI_Settings.h"
+#include "MIDI_Profile.h"
+#include "MIDI_Time.h"
+#include "MIDI_Events.h"
+#include "MIDI_Statistics.h"
+#include "MIDI_Routing.h"
+#include "MIDI_Merge.h"
+#include "MIDI_Scheduler.h"
+#include "MIDI_Clock.h"
+#include "MIDI_TimeCode.h"
+#include "MIDI_File.h"
+#include "MIDI_Notes.h"
+#include "MIDI_Controllers.h"
+#include "MIDI_UMP.h"
+#include "MIDI_MPE.h"
+
+
+/*! \brief Port independent part of the MIDI handling.
+
+ Parsing, input filtering and callback dispatching do not depend on the serial
+ port, so they live here and are compiled only once, even when several
+ MIDI_Interface instances (eg: UART and USB) are used in the same program.
+ The buffers sized by the settings (SysEx) belong to the interface, so the
+ parser only depends on MIDI_DefaultSettings::UseStatistics.
+ */
+template<bool UseStatistics>
+class MIDI_Parser {
+
+public:
+
+	MIDI_Parser(midimsg_header & ioMessage, byte * ioSysEx, byte * ioPending, byte inSysExMaxSize);
+
+	/*! \brief Extract an enumerated MIDI type from a status byte.
+
+	 This is a utility static method, used internally, made public so you can handle kMIDITypes more easily.
+	 */
+	static inline const kMIDIType getTypeFromStatusByte(const byte inStatus) {
+		if ((inStatus < 0x80)
+			|| (inStatus == 0xF4)
+			|| (inStatus == 0xF5)
+			|| (inStatus == 0xF9)
+			|| (inStatus == 0xFD)) return InvalidType; // data bytes and undefined.
+		if (inStatus < 0xF0) return (kMIDIType)(inStatus & 0xF0);	// Channel message, remove channel nibble.
+		else return (kMIDIType)inStatus;
+	}
+
+
+	// Getters
+	kMIDIType getType();
+	byte getChannel();
+	byte getData1();
+	byte getData2();
+	byte * getSysExArray();
+	midievent getEvent() const { return makeEvent(mMessage); }
+	bool check();
+
+	byte getInputChannel() { return mInputChannel; }
+
+	// Setters
+	void setInputChannel(const byte Channel);
+
+
+	// Callbacks (see MIDI_DefaultSettings::UseCallbacks)
+	void setHandleNoteOff(void (*fptr)(byte channel, byte note, byte velocity));
+	void setHandleNoteOn(void (*fptr)(byte channel, byte note, byte velocity));
+	void setHandleAfterTouchPoly(void (*fptr)(byte channel, byte note, byte pressure));
+	void setHandleControlChange(void (*fptr)(byte channel, byte number, byte value));
+	void setHandleProgramChange(void (*fptr)(byte channel, byte number));
+	void setHandleAfterTouchChannel(void (*fptr)(byte channel, byte pressure));
+	void setHandlePitchBend(void (*fptr)(byte channel, int bend));
+	void setHandleSystemExclusive(void (*fptr)(byte * array, byte size));
+	void setHandleTimeCodeQuarterFrame(void (*fptr)(byte data));
+	void setHandleSongPosition(void (*fptr)(unsigned int beats));
+	void setHandleSongSelect(void (*fptr)(byte songnumber));
+	void setHandleTuneRequest(void (*fptr)(void));
+	void setHandleClock(void (*fptr)(void));
+	void setHandleStart(void (*fptr)(void));
+	void setHandleContinue(void (*fptr)(void));
+	void setHandleStop(void (*fptr)(void));
+	void setHandleActiveSensing(void (*fptr)(void));
+	void setHandleSystemReset(void (*fptr)(void));
+	void setHandleConnectionLost(void (*fptr)(void));
+	void setHandleEvent(void (*fptr)(const midievent & event));
+
+	void disconnectCallbackFromType(kMIDIType Type);
+
+	// Statistics (see MIDI_DefaultSettings::UseStatistics)
+	void getStatistics(MIDI_Statistics & outStats) const { mStatistics.snapshot(outStats); }
+	void resetStatistics() { mStatistics.reset(); }
+
+#if MIDI_PROFILING
+	// Profiling (see MIDI_Profile.h)
+	const MIDI_ProfileStats & getProfile(kMIDIProbe inProbe) const { return mProfiler.get(inProbe); }
+	void resetProfile() { mProfiler.reset(); }
+#endif
+
+
+protected:
+
+	void init_input(const byte inChannel);
+	bool parse_byte(byte extracted);
+	bool store_message();
+	bool input_filter(byte inChannel);
+	void reset_input_attributes();
+
+	// Attributes
+	byte			mRunningStatus_RX;
+	byte			mInputChannel;
+
+	byte *			mPendingMessage;			// SysExMaxSize bytes, owned by the interface
+	byte			mSysExMaxSize;
+	byte			mPendingMessageExpectedLenght;
+	byte			mPendingMessageIndex;
+
+	midimsg_header &	mMessage;				// The interface's message
+	byte *			mSysExArray;
+
+	MIDI_StatisticsCounter<UseStatistics>	mStatistics;
+
+	void launchCallback();
+
+	void (*mNoteOffCallback)(byte channel, byte note, byte velocity);
+	void (*mNoteOnCallback)(byte channel, byte note, byte velocity);
+	void (*mAfterTouchPolyCallback)(byte channel, byte note, byte velocity);
+	void (*mControlChangeCallback)(byte channel, byte, byte);
+	void (*mProgramChangeCallback)(byte channel, byte);
+	void (*mAfterTouchChannelCallback)(byte channel, byte);
+	void (*mPitchBendCallback)(byte channel, int);
+	void (*mSystemExclusiveCallback)(byte * array, byte size);
+	void (*mTimeCodeQuarterFrameCallback)(byte data);
+	void (*mSongPositionCallback)(unsigned int beats);
+	void (*mSongSelectCallback)(byte songnumber);
+	void (*mTuneRequestCallback)(void);
+	void (*mClockCallback)(void);
+	void (*mStartCallback)(void);
+	void (*mContinueCallback)(void);
+	void (*mStopCallback)(void);
+	void (*mActiveSensingCallback)(void);
+	void (*mSystemResetCallback)(void);
+	void (*mConnectionLostCallback)(void);
+	void (*mEventCallback)(const midievent & event);
+
+#if MIDI_PROFILING
+	MIDI_Profiler	mProfiler;
+#endif
+
+};
+
+
+/*! \brief The main class for MIDI handling.\n
+	See member descriptions to know how to use it,
+	or check out the examples supplied with the library.
+
+	SerialPort is the type of the object used for MIDI I/O. It must provide
+	begin(long), available(), read(), flush() and write(uint8_t), like
+	HardwareSerial does.\n
+	Settings holds the compile-time configuration, see MIDI_DefaultSettings.
+ */
+template<class SerialPort, class Settings = MIDI_DefaultSettings>
+class MIDI_Interface : public MIDI_Parser<Settings::UseStatistics> {
+
+	typedef MIDI_Parser<Settings::UseStatistics> Parser;
+
+	// The parser keeps the SysEx size in a byte: fails to compile (negative array size) if Settings::SysExMaxSize is over 255.
+	typedef char SysExMaxSizeCheck[(Settings::SysExMaxSize <= 255) ? 1 : -1];
+
+
+public:
+	// Constructor and Destructor
+	MIDI_Interface(SerialPort& inSerial);
+	~MIDI_Interface();
+
+
+	void begin(const byte inChannel = 1);
+
+
+
+/* ####### OUTPUT ####### */
+
+public:
+
+	void sendNoteOn(byte NoteNumber,byte Velocity,byte Channel);
+	void sendNoteOff(byte NoteNumber,byte Velocity,byte Channel);
+	void sendProgramChange(byte ProgramNumber,byte Channel);
+	void sendControlChange(byte ControlNumber, byte ControlValue,byte Channel);
+	void sendControlChange14(byte ControlNumber, unsigned int ControlValue,byte Channel);
+	void sendPitchBend(int PitchValue,byte Channel);
+	void sendPitchBend(unsigned int PitchValue,byte Channel);
+	void sendPitchBend(double PitchValue,byte Channel);
+	void sendPolyPressure(byte NoteNumber,byte Pressure,byte Channel);
+	void sendAfterTouch(byte Pressure,byte Channel);
+	void sendSysEx(byte length, byte * array,bool ArrayContainsBoundaries = false);
+	void sendTimeCodeQuarterFrame(byte TypeNibble, byte ValuesNibble);
+	void sendTimeCodeQuarterFrame(byte data);
+	void sendSongPosition(unsigned int Beats);
+	void sendSongSelect(byte SongNumber);
+	void sendTuneRequest();
+	void sendRealTime(kMIDIType Type);
+
+	void send(kMIDIType type, byte param1, byte param2, byte channel);
+
+	void setRunningStatusRefresh(byte inMessages, uint16_t inMillis = 0);
+
+	void forward(kMIDIType inType, byte inData1, byte inData2, byte inChannel, byte * inSysEx);
+	void forward(const midievent & inEvent, byte * inSysEx = NULL) { forward(inEvent.getType(),inEvent.data1,inEvent.data2,inEvent.getChannel(),inSysEx); }
+
+private:
+
+	const byte genstatus(const kMIDIType inType,const byte inChannel);
+	bool status_needed(byte inStatus);
+
+
+	// Attributes
+	byte			mRunningStatus_TX;
+
+	MIDI_NoteTracker *	mOutputNotes;
+
+	byte			mStatusRefreshMessages;
+	uint16_t		mStatusRefreshMillis;
+	byte			mStatusCount;
+	uint16_t		mStatusTime;
+
+
+
+/* ####### INPUT ####### */
+
+public:
+
+	bool read();
+	bool read(const byte Channel);
+	const midimsg<Settings::SysExMaxSize> & getMessage() const { return mMessageBuffer; }
+
+	void setClockFollower(MIDI_ClockFollower * inFollower);
+	void setTimeCodeReader(MIDI_TimeCodeReader * inReader);
+
+	void setNoteTracker(MIDI_NoteTracker * inInput, MIDI_NoteTracker * inOutput);
+	void setParameterReader(MIDI_ParameterReader * inReader);
+	void setController14Reader(MIDI_Controller14Reader * inReader);
+	void setMPEReader(MIDI_MPEReader * inReader);
+
+	void setSensingAction(byte inActions);
+	bool isSensing() { return mSensingActive; }
+
+private:
+
+	bool parse(byte inChannel);
+	void feed_readers();
+	void sensing_timeout();
+	bool sensing_release(byte inChannel);
+
+	bool					mSensingActive;		// Active Sensing received, the input is watched.
+	uint16_t				mSensingTime;		// Time of the last byte received
+	byte					mSensingActions;
+	uint16_t				mSensingChannels;	// Channels which received notes
+	uint16_t				mSensingRelease;	// Channels to release locally
+
+	MIDI_ClockFollower *	mClockFollower;
+	MIDI_TimeCodeReader *	mTimeCodeReader;
+	MIDI_NoteTracker *		mInputNotes;
+	MIDI_ParameterReader *	mParameterReader;
+	MIDI_Controller14Reader *	mController14Reader;
+	MIDI_MPEReader *		mMPEReader;
+
+	using Parser::mInputChannel;
+	using Parser::mMessage;
+	using Parser::init_input;
+	using Parser::parse_byte;
+	using Parser::input_filter;
+	using Parser::launchCallback;
+	using Parser::mStatistics;
+
+
+
+/* ####### THRU (see MIDI_DefaultSettings::Thru) ####### */
+
+public:
+
+	// Getters
+	kThruFilterMode getFilterMode() { return mThruFilterMode; }
+	bool getThruState() { return mThruActivated; }
+
+
+	// Setters
+	void turnThruOn(kThruFilterMode inThruFilterMode = Full);
+	void turnThruOff();
+
+	void setThruFilterMode(const kThruFilterMode inThruFilterMode);
+	void setThruFilterMode(const byte inThruFilterMode);	// For compatibility only, avoid in future programs.
+
+	void setRouter(MIDI_Router * inRouter, byte inPort);
+
+
+private:
+
+	void thru_filter(byte inChannel);
+	void thru_cut_through(byte inByte, byte inChannel);
+
+	bool				mThruActivated;
+	kThruFilterMode		mThruFilterMode;
+	byte				mThruStatus;
+
+	MIDI_Router *		mRouter;
+	byte				mRouterPort;
+
+
+
+private:
+
+	midimsg<Settings::SysExMaxSize>	mMessageBuffer;		// Filled by the parser
+	byte			mPendingBuffer[Settings::SysExMaxSize];
+
+	SerialPort&			mSerial;
+
+};
+
+
+#include "MIDI_Core.hpp"
+
+#endif // LIB_MIDI_CORE_H_
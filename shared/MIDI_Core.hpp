@@ -0,0 +1,1302 @@
+/*!
+ *  @file		MIDI_Core.hpp
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Platform independent core (implementation)
+ *	@version	3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  license		GPL Forty Seven Effects - 2011
+ *
+ *  Included by MIDI_Core.h, do not include this file directly.
+ */
+
+#ifndef LIB_MIDI_CORE_HPP_
+#define LIB_MIDI_CORE_HPP_
+
+
+/*! \brief Constructor for MIDI_Parser.
+ \param ioMessage	The message received, stored by the interface.
+ \param ioSysEx		The SysEx array of ioMessage.
+ \param ioPending	The buffer of the message being received, of inSysExMaxSize bytes.
+ \param inSysExMaxSize	The size of the SysEx buffers (see MIDI_DefaultSettings::SysExMaxSize).
+ */
+template<bool UseStatistics>
+MIDI_Parser<UseStatistics>::MIDI_Parser(midimsg_header & ioMessage, byte * ioSysEx, byte * ioPending, byte inSysExMaxSize)
+	: mPendingMessage(ioPending), mSysExMaxSize(inSysExMaxSize), mMessage(ioMessage), mSysExArray(ioSysEx) {
+	// Initialise callbacks to NULL pointer
+	mNoteOffCallback = NULL;
+	mNoteOnCallback = NULL;
+	mAfterTouchPolyCallback = NULL;
+	mControlChangeCallback = NULL;
+	mProgramChangeCallback = NULL;
+	mAfterTouchChannelCallback = NULL;
+	mPitchBendCallback = NULL;
+	mSystemExclusiveCallback = NULL;
+	mTimeCodeQuarterFrameCallback = NULL;
+	mSongPositionCallback = NULL;
+	mSongSelectCallback = NULL;
+	mTuneRequestCallback = NULL;
+	mClockCallback = NULL;
+	mStartCallback = NULL;
+	mContinueCallback = NULL;
+	mStopCallback = NULL;
+	mActiveSensingCallback = NULL;
+	mSystemResetCallback = NULL;
+	mConnectionLostCallback = NULL;
+	mEventCallback = NULL;
+}
+
+
+/*! \brief Constructor for MIDI_Interface.
+ \param inSerial	The serial port object used for MIDI I/O.
+ */
+template<class SerialPort, class Settings>
+MIDI_Interface<SerialPort, Settings>::MIDI_Interface(SerialPort& inSerial) : Parser(mMessageBuffer,mMessageBuffer.sysex_array,mPendingBuffer,Settings::SysExMaxSize), mOutputNotes(NULL), mClockFollower(NULL), mTimeCodeReader(NULL), mInputNotes(NULL), mParameterReader(NULL), mController14Reader(NULL), mMPEReader(NULL), mRouter(NULL), mRouterPort(0), mSerial(inSerial) { }
+
+/*! \brief Default destructor for MIDI_Interface.
+
+ This is not really useful for the Arduino, as it is never called...
+ */
+template<class SerialPort, class Settings>
+MIDI_Interface<SerialPort, Settings>::~MIDI_Interface() { }
+
+
+/*! \brief Call the begin method in the setup() function of the Arduino.
+
+ All parameters are set to their default values:
+ - Input channel set to 1 if no value is specified
+ - Full thru mirroring
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::begin(const byte inChannel) {
+
+	// Initialise the Serial port
+	mSerial.begin(MIDI_BAUDRATE);
+
+
+	mRunningStatus_TX = InvalidType;
+	mStatusRefreshMessages = 0;
+	mStatusRefreshMillis = 0;
+	mStatusCount = 0;
+
+	init_input(inChannel);
+
+	mSensingActive = false;
+	mSensingActions = SensingNotify;
+	mSensingChannels = 0;
+	mSensingRelease = 0;
+
+	mThruFilterMode = Full;
+	mThruActivated = Settings::Thru;
+	mThruStatus = 0;
+
+}
+
+
+// Private method for generating a status byte from channel and type
+template<class SerialPort, class Settings>
+const byte MIDI_Interface<SerialPort, Settings>::genstatus(const kMIDIType inType,const byte inChannel) {
+	return ((byte)inType | ((inChannel-1) & 0x0F));
+}
+
+// Private method: running status check for an outgoing channel status byte, returns true if it must be sent.
+template<class SerialPort, class Settings>
+bool MIDI_Interface<SerialPort, Settings>::status_needed(byte inStatus) {
+
+	// Don't care about running status, send the Control byte.
+	if (!Settings::UseRunningStatus) return true;
+
+	if (mRunningStatus_TX == inStatus) {
+
+		// Same status: skip it, unless it is time to refresh it (see setRunningStatusRefresh()).
+		const bool refresh = ((mStatusRefreshMessages != 0) && (++mStatusCount >= mStatusRefreshMessages))
+			|| ((mStatusRefreshMillis != 0) && ((uint16_t)(MIDI_MILLIS() - mStatusTime) >= mStatusRefreshMillis));
+
+		if (!refresh) {
+			mStatistics.runningStatusHit();
+			return false;
+		}
+	}
+
+	// New message (or refresh), memorise and send header
+	mRunningStatus_TX = inStatus;
+	mStatusCount = 0;
+	if (mStatusRefreshMillis != 0) mStatusTime = MIDI_MILLIS();
+	return true;
+}
+
+/*! \brief Re-send the running status byte periodically, so a receiver that missed a byte gets back in sync.
+ \param inMessages	The status byte is sent at least once every inMessages channel messages (0: no limit).
+ \param inMillis	The status byte is sent again if the last one is older than inMillis ms (0: no limit, needs MIDI_MILLIS(), see MIDI_Time.h).
+
+ By default (and after begin()), the status byte is only sent when it changes.
+ Example: setRunningStatusRefresh(16,100) keeps most of the running status gain on dense streams.
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::setRunningStatusRefresh(byte inMessages, uint16_t inMillis) {
+	mStatusRefreshMessages = inMessages;
+	mStatusRefreshMillis = inMillis;
+	mStatusCount = 0;
+	mStatusTime = MIDI_MILLIS();
+}
+
+/*! \brief Generate and send a MIDI message from the values given.
+ \param type	The message type (see type defines for reference)
+ \param data1	The first data byte.
+ \param data2	The second data byte (if the message contains only 1 data byte, set this one to 0).
+ \param channel	The output channel on which the message will be sent (values from 1 to 16). Note: you cannot send to OMNI.
+
+ This is an internal method, use it only if you need to send raw data from your code, at your own risks.
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::send(kMIDIType type, byte data1, byte data2, byte channel) {
+
+	// Then test if channel is valid
+	if (channel >= MIDI_CHANNEL_OFF || channel == MIDI_CHANNEL_OMNI || type < NoteOff) {
+
+		mRunningStatus_TX = InvalidType;
+
+		return; // Don't send anything
+	}
+
+	if (type <= PitchBend) {
+		// Channel messages
+
+		// Protection: remove MSBs on data
+		data1 &= 0x7F;
+		data2 &= 0x7F;
+
+		if (mOutputNotes != NULL) mOutputNotes->process(type,data1,data2,channel);
+
+		// Counted as asked: a Note Off sent as a Note On is still a Note Off.
+		mStatistics.sent(type);
+
+		if (Settings::NoteOffAsNoteOn && type == NoteOff) {
+			// Same status as Note On, for running status (see MIDI_DefaultSettings::NoteOffAsNoteOn).
+			type = NoteOn;
+			data2 = 0;
+		}
+
+		byte statusbyte = genstatus(type,channel);
+
+		// Check Running Status
+		if (status_needed(statusbyte)) mSerial.write(statusbyte);
+
+		// Then send data
+		mSerial.write(data1);
+		if (type != ProgramChange && type != AfterTouchChannel) {
+			mSerial.write(data2);
+		}
+		return;
+	}
+	if (type >= TuneRequest && type <= SystemReset) {
+		// System Real-time and 1 byte.
+		sendRealTime(type);
+	}
+
+}
+
+/*! \brief Send a message received from another port (used by the Thru and MIDI_Router).
+ \param inType		The message type.
+ \param inData1	The first data byte (SysEx: the length of inSysEx).
+ \param inData2	The second data byte.
+ \param inChannel	The channel of channel messages (1 to 16).
+ \param inSysEx	The SysEx array, 0xF0 and 0xF7 included (as stored by the parser).
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::forward(kMIDIType inType, byte inData1, byte inData2, byte inChannel, byte * inSysEx) {
+
+	switch (inType) {
+			// Real Time and 1 byte
+		case Clock:
+		case Start:
+		case Stop:
+		case Continue:
+		case ActiveSensing:
+		case SystemReset:
+		case TuneRequest:
+			sendRealTime(inType);
+			break;
+
+		case SystemExclusive:
+			// Send SysEx (0xF0 and 0xF7 are included in the buffer)
+			sendSysEx(inData1,inSysEx,true);
+			break;
+
+		case SongSelect:
+			sendSongSelect(inData1);
+			break;
+
+		case SongPosition:
+			sendSongPosition(inData1 | ((unsigned)inData2<<7));
+			break;
+
+		case TimeCodeQuarterFrame:
+			sendTimeCodeQuarterFrame(inData1);
+			break;
+
+		default:
+			// Channel messages
+			send(inType,inData1,inData2,inChannel);
+			break;
+	}
+
+}
+
+/*! \brief Send a Note On message
+ \param NoteNumber	Pitch value in the MIDI format (0 to 127). Take a look at the values, names and frequencies of notes here: http://www.phys.unsw.edu.au/jw/notes.html\n
+ \param Velocity	Note attack velocity (0 to 127). A NoteOn with 0 velocity is considered as a NoteOff.
+ \param Channel		The channel on which the message will be sent (1 to 16).
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendNoteOn(byte NoteNumber,byte Velocity,byte Channel) { send(NoteOn,NoteNumber,Velocity,Channel); }
+
+/*! \brief Send a Note Off message (a real Note Off, not a Note On with null velocity, unless MIDI_DefaultSettings::NoteOffAsNoteOn is set)
+ \param NoteNumber	Pitch value in the MIDI format (0 to 127). Take a look at the values, names and frequencies of notes here: http://www.phys.unsw.edu.au/jw/notes.html\n
+ \param Velocity	Release velocity (0 to 127).
+ \param Channel		The channel on which the message will be sent (1 to 16).
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendNoteOff(byte NoteNumber,byte Velocity,byte Channel) { send(NoteOff,NoteNumber,Velocity,Channel); }
+
+/*! \brief Send a Program Change message
+ \param ProgramNumber	The Program to select (0 to 127).
+ \param Channel			The channel on which the message will be sent (1 to 16).
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendProgramChange(byte ProgramNumber,byte Channel) { send(ProgramChange,ProgramNumber,0,Channel); }
+
+/*! \brief Send a Control Change message
+ \param ControlNumber	The controller number (0 to 127). See the detailed description here: http://www.somascape.org/midi/tech/spec.html#ctrlnums
+ \param ControlValue	The value for the specified controller (0 to 127).
+ \param Channel			The channel on which the message will be sent (1 to 16).
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendControlChange(byte ControlNumber, byte ControlValue,byte Channel) { send(ControlChange,ControlNumber,ControlValue,Channel); }
+
+/*! \brief Send a 14-bit Control Change: the MSB on ControlNumber, then the LSB on ControlNumber + 32.
+ \param ControlNumber	The controller number of the MSB (0 to 31).
+ \param ControlValue	The value (0 to 16383).
+ \param Channel			The channel on which the message will be sent (1 to 16).
+
+ Both are always sent, MIDI_ControllerCache::sendControlChange14() only sends the LSB when the MSB is unchanged.
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendControlChange14(byte ControlNumber, unsigned int ControlValue,byte Channel) {
+
+	send(ControlChange,ControlNumber & 0x1F,(ControlValue >> 7) & 0x7F,Channel);
+	send(ControlChange,(ControlNumber & 0x1F) + 32,ControlValue & 0x7F,Channel);
+
+}
+
+/*! \brief Send a Polyphonic AfterTouch message (applies to only one specified note)
+ \param NoteNumber		The note to apply AfterTouch to (0 to 127).
+ \param Pressure		The amount of AfterTouch to apply (0 to 127).
+ \param Channel			The channel on which the message will be sent (1 to 16).
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendPolyPressure(byte NoteNumber,byte Pressure,byte Channel) { send(AfterTouchPoly,NoteNumber,Pressure,Channel); }
+
+/*! \brief Send a MonoPhonic AfterTouch message (applies to all notes)
+ \param Pressure		The amount of AfterTouch to apply to all notes.
+ \param Channel			The channel on which the message will be sent (1 to 16).
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendAfterTouch(byte Pressure,byte Channel) { send(AfterTouchChannel,Pressure,0,Channel); }
+
+/*! \brief Send a Pitch Bend message using a signed integer value.
+ \param PitchValue	The amount of bend to send (in a signed integer format), between -8192 (maximum downwards bend) and 8191 (max upwards bend), center value is 0.
+ \param Channel		The channel on which the message will be sent (1 to 16).
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendPitchBend(int PitchValue,byte Channel) {
+
+	unsigned int bend = PitchValue + 8192;
+	sendPitchBend(bend,Channel);
+
+}
+/*! \brief Send a Pitch Bend message using an unsigned integer value.
+ \param PitchValue	The amount of bend to send (in a signed integer format), between 0 (maximum downwards bend) and 16383 (max upwards bend), center value is 8192.
+ \param Channel		The channel on which the message will be sent (1 to 16).
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendPitchBend(unsigned int PitchValue,byte Channel) {
+
+	send(PitchBend,(PitchValue & 0x7F),(PitchValue >> 7) & 0x7F,Channel);
+
+}
+/*! \brief Send a Pitch Bend message using a floating point value.
+ \param PitchValue	The amount of bend to send (in a floating point format), between -1.0f (maximum downwards bend) and +1.0f (max upwards bend), center value is 0.0f.
+ \param Channel		The channel on which the message will be sent (1 to 16).
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendPitchBend(double PitchValue,byte Channel) {
+
+	unsigned int pitchval = (PitchValue+1.f)*8192;
+	if (pitchval > 16383) pitchval = 16383;		// overflow protection
+	sendPitchBend(pitchval,Channel);
+
+}
+
+/*! \brief Generate and send a System Exclusive frame.
+ \param length	The size of the array to send
+ \param array	The byte array containing the data to send
+ \param ArrayContainsBoundaries  When set to 'true', 0xF0 & 0xF7 bytes (start & stop SysEx) will NOT be sent (and therefore must be included in the array).
+ default value is set to 'false' for compatibility with previous versions of the library.
+ With boundaries, a SysEx can be sent in several parts (eg: by MIDI_Merger), it is counted in the statistics with its first part (0xF0).
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendSysEx(byte length, byte * array, bool ArrayContainsBoundaries) {
+	if (!ArrayContainsBoundaries) mSerial.write(0xF0);
+	for (byte i=0;i<length;i++) mSerial.write(array[i]);
+	if (!ArrayContainsBoundaries) mSerial.write(0xF7);
+	mRunningStatus_TX = InvalidType;
+	if (!ArrayContainsBoundaries || (length > 0 && array[0] == 0xF0)) mStatistics.sent(SystemExclusive);
+}
+
+/*! \brief Send a Tune Request message.
+
+ When a MIDI unit receives this message, it should tune its oscillators (if equipped with any)
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendTuneRequest() { sendRealTime(TuneRequest); }
+
+/*! \brief Send a MIDI Time Code Quarter Frame.
+
+ See MIDI Specification for more information.
+ \param TypeNibble	MTC type
+ \param ValuesNibble	MTC data
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendTimeCodeQuarterFrame(byte TypeNibble, byte ValuesNibble) {
+
+	byte data = ( ((TypeNibble & 0x07) << 4) | (ValuesNibble & 0x0F) );
+	sendTimeCodeQuarterFrame(data);
+
+}
+
+/*! \brief Send a MIDI Time Code Quarter Frame.
+
+ See MIDI Specification for more information.
+ \param data	 if you want to encode directly the nibbles in your program, you can send the byte here.
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendTimeCodeQuarterFrame(byte data) {
+
+	mSerial.write((byte)TimeCodeQuarterFrame);
+	mSerial.write(data);
+	mRunningStatus_TX = InvalidType;
+	mStatistics.sent(TimeCodeQuarterFrame);
+}
+
+/*! \brief Send a Song Position Pointer message.
+ \param Beats	The number of beats since the start of the song.
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendSongPosition(unsigned int Beats) {
+
+	mSerial.write((byte)SongPosition);
+	mSerial.write(Beats & 0x7F);
+	mSerial.write((Beats >> 7) & 0x7F);
+	mRunningStatus_TX = InvalidType;
+	mStatistics.sent(SongPosition);
+}
+
+/*! \brief Send a Song Select message */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendSongSelect(byte SongNumber) {
+
+	mSerial.write((byte)SongSelect);
+	mSerial.write(SongNumber & 0x7F);
+	mRunningStatus_TX = InvalidType;
+	mStatistics.sent(SongSelect);
+}
+
+/*! \brief Send a Real Time (one byte) message.
+
+ \param Type The available Real Time types are: Start, Stop, Continue, Clock, ActiveSensing and SystemReset.
+ You can also send a Tune Request with this method.
+ @see kMIDIType
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sendRealTime(kMIDIType Type) {
+	switch (Type) {
+		case TuneRequest: // Not really real-time, but one byte anyway.
+		case Clock:
+		case Start:
+		case Stop:
+		case Continue:
+		case ActiveSensing:
+		case SystemReset:
+			mSerial.write((byte)Type);
+			mStatistics.sent(Type);
+			if (Type == SystemReset && mOutputNotes != NULL) mOutputNotes->reset();
+			break;
+		default:
+			// Invalid Real Time marker
+			break;
+	}
+
+	// Do not cancel Running Status for real-time messages as they can be interleaved within any message.
+	// Though, TuneRequest can be sent here, and as it is a System Common message, it must reset Running Status.
+	if (Type == TuneRequest) mRunningStatus_TX = InvalidType;
+
+}
+
+/*! \brief Read a MIDI message from the serial port using the main input channel (see setInputChannel() for reference).
+
+ Returned value: true if any valid message has been stored in the structure, false if not.
+ A valid message is a message that matches the input channel. \n\n
+ If the Thru is enabled and the messages matches the filter, it is sent back on the MIDI output.
+ */
+template<class SerialPort, class Settings>
+bool MIDI_Interface<SerialPort, Settings>::read() {
+	return read(mInputChannel);
+}
+
+/*! \brief Reading/thru-ing method, the same as read() with a given input channel to read on. */
+template<class SerialPort, class Settings>
+bool MIDI_Interface<SerialPort, Settings>::read(const byte inChannel) {
+
+	if (inChannel >= MIDI_CHANNEL_OFF) return false; // MIDI Input disabled.
+
+	if (mSensingRelease != 0) return sensing_release(inChannel);
+
+	if (parse(inChannel)) {
+
+		if (Settings::Thru && (!Settings::ThruCutThrough || mRouter != NULL)) {
+			MIDI_PROFILE_BEGIN(ProbeThruFilter);
+			thru_filter(inChannel);
+			MIDI_PROFILE_END(ProbeThruFilter);
+		}
+
+		MIDI_PROFILE_BEGIN(ProbeInputFilter);
+		const bool accepted = input_filter(inChannel);
+		MIDI_PROFILE_END(ProbeInputFilter);
+
+		if (accepted) {
+
+			if (Settings::UseCallbacks) {
+				MIDI_PROFILE_BEGIN(ProbeCallback);
+				launchCallback();
+				MIDI_PROFILE_END(ProbeCallback);
+			}
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Private method: pull bytes from the serial port and feed them to the parser
+template<class SerialPort, class Settings>
+bool MIDI_Interface<SerialPort, Settings>::parse(byte inChannel) {
+
+	// If the buffer is full -> Don't Panic! Call the Vogons to destroy it.
+	if (mSerial.available() == Settings::SerialBufferSize) {
+		mSerial.flush();
+		mStatistics.bufferFlush();
+	}
+
+	if (mSerial.available() <= 0) {
+		// No data available: check the Active Sensing timeout.
+		if (mSensingActive && (uint16_t)(MIDI_MILLIS() - mSensingTime) > MIDI_SENSING_TIMEOUT) sensing_timeout();
+		return false;
+	}
+
+	if (mSensingActive) mSensingTime = MIDI_MILLIS();
+
+	MIDI_PROFILE_BEGIN(ProbeParse);
+
+	// Assemble the message from the available bytes, until it is complete or the buffer is empty.
+	bool complete = false;
+	while (!complete && mSerial.available() > 0) {
+		const byte extracted = mSerial.read();
+		if (Settings::Thru && Settings::ThruCutThrough) thru_cut_through(extracted,inChannel);
+		complete = parse_byte(extracted);
+	}
+
+	MIDI_PROFILE_END(ProbeParse);
+
+	if (complete) {
+		mStatistics.received(mMessage.type);
+		if (mMessage.type == NoteOn) mSensingChannels |= 1U << (mMessage.channel - 1);
+		else if (mMessage.type == ActiveSensing && !mSensingActive) {
+			mSensingActive = true;
+			mSensingTime = MIDI_MILLIS();
+		}
+		feed_readers();
+	}
+
+	return complete;
+}
+
+// Private method: give the message received to the attached followers, trackers and readers.
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::feed_readers() {
+
+	if (mClockFollower != NULL && mMessage.type >= SongPosition) {
+		mClockFollower->received(mMessage.type,mMessage.data1,mMessage.data2,MIDI_MICROS());
+	}
+	if (mInputNotes != NULL) mInputNotes->process(mMessage.type,mMessage.data1,mMessage.data2,mMessage.channel);
+	if (mParameterReader != NULL) mParameterReader->received(mMessage.type,mMessage.data1,mMessage.data2,mMessage.channel);
+	if (mController14Reader != NULL) mController14Reader->received(mMessage.type,mMessage.data1,mMessage.data2,mMessage.channel);
+	if (mMPEReader != NULL) mMPEReader->received(mMessage.type,mMessage.data1,mMessage.data2,mMessage.channel);
+	if (mTimeCodeReader != NULL && (mMessage.type == TimeCodeQuarterFrame || mMessage.type == SystemExclusive)) {
+		mTimeCodeReader->received(mMessage.type,mMessage.data1,mMessageBuffer.sysex_array);
+	}
+}
+
+
+/*! \brief Choose what happens when the Active Sensing stops (see kSensingAction), in addition to the ConnectionLost callback.
+ \param inActions	SensingNotify, or SensingSendNotesOff and/or SensingLocalNotesOff.
+
+ Once an Active Sensing message was received, the input is watched: if no
+ byte comes for MIDI_SENSING_TIMEOUT ms, the connection is considered lost
+ (checked by read()), and the watch stops until the next Active Sensing.
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::setSensingAction(byte inActions) {
+	mSensingActions = inActions;
+}
+
+// Private method: the Active Sensing stopped, release the notes.
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::sensing_timeout() {
+
+	mSensingActive = false;
+
+	if (mSensingActions & SensingSendNotesOff) {
+		for (byte channel=1;channel<=16;channel++) {
+			if (mSensingChannels & (1U << (channel - 1))) send(ControlChange,123,0,channel);
+		}
+	}
+	if (mSensingActions & SensingLocalNotesOff) mSensingRelease = mSensingChannels;
+	mSensingChannels = 0;
+
+	if (Settings::UseCallbacks && this->mConnectionLostCallback != NULL) this->mConnectionLostCallback();
+}
+
+// Private method: return an All Notes Off from read(), for the next channel to release locally, as if it was received.
+template<class SerialPort, class Settings>
+bool MIDI_Interface<SerialPort, Settings>::sensing_release(byte inChannel) {
+
+	byte channel = 1;
+	while (!(mSensingRelease & (1U << (channel - 1)))) channel++;
+	mSensingRelease &= ~(1U << (channel - 1));
+
+	mMessage.type = ControlChange;
+	mMessage.channel = channel;
+	mMessage.data1 = 123;
+	mMessage.data2 = 0;
+	mMessage.valid = true;
+
+	// Received like the others: the note tracker and the readers release the channel too.
+	feed_readers();
+
+	if (!input_filter(inChannel)) return false;
+	if (Settings::UseCallbacks) launchCallback();
+	return true;
+}
+
+
+/*! \brief Track the notes received and/or sent.
+ \param inInput	The tracker of the notes received by read(), NULL for none.
+ \param inOutput	The tracker of the notes sent (Thru included), NULL for none. It can be the same as inInput.
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::setNoteTracker(MIDI_NoteTracker * inInput, MIDI_NoteTracker * inOutput) {
+	mInputNotes = inInput;
+	mOutputNotes = inOutput;
+}
+
+/*! \brief Feed a MIDI_ParameterReader with the messages received, to assemble the RPN and NRPN.
+ \param inReader	The reader, NULL to detach it.
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::setParameterReader(MIDI_ParameterReader * inReader) {
+	mParameterReader = inReader;
+}
+
+/*! \brief Feed a MIDI_Controller14Reader with the messages received, to assemble the 14-bit Control Changes.
+ \param inReader	The reader, NULL to detach it.
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::setController14Reader(MIDI_Controller14Reader * inReader) {
+	mController14Reader = inReader;
+}
+
+/*! \brief Feed a MIDI_MPEReader with the messages received, to follow the expression of the MPE notes.
+ \param inReader	The reader, NULL to detach it.
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::setMPEReader(MIDI_MPEReader * inReader) {
+	mMPEReader = inReader;
+}
+
+/*! \brief Feed a MIDI_ClockFollower with the Clock, Start, Stop, Continue and Song Position messages received.
+ \param inFollower	The follower, NULL to detach it.
+
+ The messages are timestamped when parsed, before the Thru and the callbacks:
+ call read() often for an accurate tempo estimation.
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::setClockFollower(MIDI_ClockFollower * inFollower) {
+	mClockFollower = inFollower;
+}
+
+/*! \brief Feed a MIDI_TimeCodeReader with the Time Code Quarter Frames and the Full Frame messages received.
+ \param inReader	The reader, NULL to detach it.
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::setTimeCodeReader(MIDI_TimeCodeReader * inReader) {
+	mTimeCodeReader = inReader;
+}
+
+
+// Protected method: initialise input attributes (called by begin)
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::init_input(const byte inChannel) {
+
+	mInputChannel = inChannel;
+	mRunningStatus_RX = InvalidType;
+	mPendingMessageIndex = 0;
+	mPendingMessageExpectedLenght = 0;
+
+	mMessage.valid = false;
+	mMessage.type = InvalidType;
+	mMessage.channel = 0;
+	mMessage.data1 = 0;
+	mMessage.data2 = 0;
+
+}
+
+// Protected method: MIDI parser, processes one byte. Returns true when a message has been stored in mMessage.
+template<bool UseStatistics>
+bool MIDI_Parser<UseStatistics>::parse_byte(byte extracted) {
+
+	/* Parsing algorithm:
+	 * If there is no pending message to be recomposed, start a new one.
+	 - Find type and channel (if pertinent)
+	 - Wait for the other bytes, until the message is assembled.
+	 * Else, add the extracted byte to the pending message, and check validity. When the message is done, store it.
+	 */
+
+	if (mPendingMessageIndex == 0) { // Start a new pending message
+		mPendingMessage[0] = extracted;
+
+		// Check for running status first
+		switch (getTypeFromStatusByte(mRunningStatus_RX)) {
+				// Only these types allow Running Status:
+			case NoteOff:
+			case NoteOn:
+			case AfterTouchPoly:
+			case ControlChange:
+			case ProgramChange:
+			case AfterTouchChannel:
+			case PitchBend:
+
+				// If the status byte is not received, prepend it to the pending message
+				if (extracted < 0x80) {
+					mPendingMessage[0] = mRunningStatus_RX;
+					mPendingMessage[1] = extracted;
+					mPendingMessageIndex = 1;
+				}
+				// Else: well, we received another status byte, so the running status does not apply here.
+				// It will be updated upon completion of this message.
+
+				break;
+
+			default:
+				// No running status
+				break;
+		}
+
+
+		switch (getTypeFromStatusByte(mPendingMessage[0])) {
+
+				// 1 byte messages
+			case Start:
+			case Continue:
+			case Stop:
+			case Clock:
+			case ActiveSensing:
+			case SystemReset:
+			case TuneRequest:
+				// Handle the message type directly here.
+				mMessage.type = getTypeFromStatusByte(mPendingMessage[0]);
+				mMessage.channel = 0;
+				mMessage.data1 = 0;
+				mMessage.data2 = 0;
+				mMessage.valid = true;
+				// Real Time messages can be received between running status messages,
+				// only Tune Request (System Common) cancels the running status.
+				if (mMessage.type == TuneRequest) reset_input_attributes();
+				return true;
+				break;
+
+				// 2 bytes messages
+			case ProgramChange:
+			case AfterTouchChannel:
+			case TimeCodeQuarterFrame:
+			case SongSelect:
+				mPendingMessageExpectedLenght = 2;
+				break;
+
+				// 3 bytes messages
+			case NoteOn:
+			case NoteOff:
+			case ControlChange:
+			case PitchBend:
+			case AfterTouchPoly:
+			case SongPosition:
+				mPendingMessageExpectedLenght = 3;
+				break;
+
+			case SystemExclusive:
+				mPendingMessageExpectedLenght = mSysExMaxSize; // As the message can be any lenght between 3 and SysExMaxSize bytes
+				mRunningStatus_RX = InvalidType;
+				break;
+
+			case InvalidType:
+			default:
+				// This is obviously wrong. Let's get the hell out'a here.
+				// Undefined Real Time bytes (0xF9, 0xFD) are ignored, anything else cancels the running status.
+				mStatistics.parseError();
+				if (extracted < 0xF8) reset_input_attributes();
+				return false;
+				break;
+		}
+
+		// Then update the index of the pending message.
+		mPendingMessageIndex++;
+
+		// With running status, a 2 bytes message is complete with its first data byte.
+		if (mPendingMessageIndex >= mPendingMessageExpectedLenght) return store_message();
+
+		// And wait for the next byte.
+		return false;
+
+	}
+	else {
+
+
+		// First, test if this is a status byte
+		if (extracted >= 0x80) {
+
+			// Reception of status bytes in the middle of an uncompleted message
+			// are allowed only for interleaved Real Time message or EOX
+			switch (extracted) {
+				case Clock:
+				case Start:
+				case Continue:
+				case Stop:
+				case ActiveSensing:
+				case SystemReset:
+
+					/*
+					 This is tricky. Here we will have to extract the one-byte message,
+					 pass it to the structure for being read outside the MIDI class,
+					 and recompose the message it was interleaved into.
+
+					 Oh, and without killing the running status..
+
+					 This is done by leaving the pending message as is, it will be completed on next calls.
+					 */
+
+					mMessage.type = (kMIDIType)extracted;
+					mMessage.data1 = 0;
+					mMessage.data2 = 0;
+					mMessage.channel = 0;
+					mMessage.valid = true;
+					return true;
+
+					break;
+
+					// Undefined Real Time: ignore it, the pending message goes on.
+				case 0xF9:
+				case 0xFD:
+					mStatistics.parseError();
+					return false;
+					break;
+
+					// End of Exclusive
+				case 0xF7:
+					if (getTypeFromStatusByte(mPendingMessage[0]) == SystemExclusive) {
+
+						// Store System Exclusive array in midimsg structure (0xF0 and 0xF7 included).
+						// The index is always lower than SysExMaxSize here, see the "FML" case below.
+						mPendingMessage[mPendingMessageIndex] = 0xF7;
+						for (unsigned i=0;i<=mPendingMessageIndex;i++) {
+							mSysExArray[i] = mPendingMessage[i];
+						}
+
+						mMessage.type = SystemExclusive;
+						mMessage.data1 = mPendingMessageIndex+1;	// Get length
+						mMessage.data2 = 0;
+						mMessage.channel = 0;
+						mMessage.valid = true;
+
+						reset_input_attributes();
+
+						return true;
+					}
+					else {
+						// Well well well.. error.
+						mStatistics.parseError();
+						reset_input_attributes();
+						return false;
+					}
+
+					break;
+
+				default:
+					// Any other status byte cancels the uncompleted message (SysEx included),
+					// and starts a new one.
+					mStatistics.parseError();
+					reset_input_attributes();
+					return parse_byte(extracted);
+					break;
+			}
+
+		}
+
+
+		// Add extracted data byte to pending message
+		mPendingMessage[mPendingMessageIndex] = extracted;
+
+
+		// Now we are going to check if we have reached the end of the message
+		if (mPendingMessageIndex >= (mPendingMessageExpectedLenght-1)) {
+
+			// "FML" case: fall down here with an overflown SysEx..
+			// This means we received the last possible data byte that can fit the buffer.
+			// If this happens, try increasing SysExMaxSize in the settings.
+			if (getTypeFromStatusByte(mPendingMessage[0]) == SystemExclusive) {
+				mStatistics.sysexOverflow();
+				reset_input_attributes();
+				return false;
+			}
+
+			return store_message();
+		}
+		else {
+			// Then update the index of the pending message.
+			mPendingMessageIndex++;
+
+			// And wait for the next byte.
+			return false;
+		}
+
+	}
+
+}
+
+
+// Protected method: store the completed pending message (Channel or System Common) in mMessage.
+template<bool UseStatistics>
+bool MIDI_Parser<UseStatistics>::store_message() {
+
+	mMessage.type = getTypeFromStatusByte(mPendingMessage[0]);
+	mMessage.channel = (mPendingMessage[0] & 0x0F)+1; // Don't check if it is a Channel Message
+
+	mMessage.data1 = mPendingMessage[1];
+
+	// Save data2 only if applicable
+	if (mPendingMessageExpectedLenght == 3)	mMessage.data2 = mPendingMessage[2];
+	else mMessage.data2 = 0;
+
+	// Reset local variables
+	mPendingMessageIndex = 0;
+	mPendingMessageExpectedLenght = 0;
+
+	mMessage.valid = true;
+
+	// Activate running status (if enabled for the received type)
+	switch (mMessage.type) {
+		case NoteOff:
+		case NoteOn:
+		case AfterTouchPoly:
+		case ControlChange:
+		case ProgramChange:
+		case AfterTouchChannel:
+		case PitchBend:
+			// Running status enabled: store it from received message
+			mRunningStatus_RX = mPendingMessage[0];
+			break;
+
+		default:
+			// No running status
+			mRunningStatus_RX = InvalidType;
+			break;
+	}
+	return true;
+}
+
+
+// Protected method: check if the received message is on the listened channel
+template<bool UseStatistics>
+bool MIDI_Parser<UseStatistics>::input_filter(byte inChannel) {
+
+
+	// This method handles recognition of channel (to know if the message is destinated to the Arduino)
+
+
+	if (mMessage.type == InvalidType) return false;
+
+
+	// First, check if the received message is Channel
+	if (mMessage.type >= NoteOff && mMessage.type <= PitchBend) {
+
+		// Then we need to know if we listen to it
+		if ((mMessage.channel == inChannel) || (inChannel == MIDI_CHANNEL_OMNI)) {
+			return true;
+
+		}
+		else {
+			// We don't listen to this channel
+			return false;
+		}
+
+	}
+	else {
+
+		// System messages are always received
+		return true;
+	}
+
+}
+
+// Protected method: reset input attributes
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::reset_input_attributes() {
+	mPendingMessageIndex = 0;
+	mPendingMessageExpectedLenght = 0;
+	mRunningStatus_RX = InvalidType;
+}
+
+// Getters
+/*! \brief Get the last received message's type
+
+ Returns an enumerated type. @see kMIDIType
+ */
+template<bool UseStatistics>
+kMIDIType MIDI_Parser<UseStatistics>::getType() { return mMessage.type; }
+
+/*! \brief Get the channel of the message stored in the structure.
+
+ Channel range is 1 to 16. For non-channel messages, this will return 0.
+ */
+template<bool UseStatistics>
+byte MIDI_Parser<UseStatistics>::getChannel() { return mMessage.channel; }
+
+/*! \brief Get the first data byte of the last received message.
+
+ If the message is SysEx, the length of the array is stocked there.
+ */
+template<bool UseStatistics>
+byte MIDI_Parser<UseStatistics>::getData1() { return mMessage.data1; }
+
+/*! \brief Get the second data byte of the last received message. */
+template<bool UseStatistics>
+byte MIDI_Parser<UseStatistics>::getData2() { return mMessage.data2; }
+
+/*! \brief Get the System Exclusive byte array.
+
+ Array length is stocked in Data1.
+ */
+template<bool UseStatistics>
+byte * MIDI_Parser<UseStatistics>::getSysExArray() { return mSysExArray; }
+
+/*! \brief Check if a valid message is stored in the structure. */
+template<bool UseStatistics>
+bool MIDI_Parser<UseStatistics>::check() { return mMessage.valid; }
+
+// Setters
+/*! \brief Set the value for the input MIDI channel
+ \param Channel the channel value. Valid values are 1 to 16,
+ MIDI_CHANNEL_OMNI if you want to listen to all channels, and MIDI_CHANNEL_OFF to disable MIDI input.
+ */
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setInputChannel(const byte Channel) { mInputChannel = Channel; }
+
+
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleNoteOff(void (*fptr)(byte channel, byte note, byte velocity))			{ mNoteOffCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleNoteOn(void (*fptr)(byte channel, byte note, byte velocity))			{ mNoteOnCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleAfterTouchPoly(void (*fptr)(byte channel, byte note, byte pressure))	{ mAfterTouchPolyCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleControlChange(void (*fptr)(byte channel, byte number, byte value))	{ mControlChangeCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleProgramChange(void (*fptr)(byte channel, byte number))				{ mProgramChangeCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleAfterTouchChannel(void (*fptr)(byte channel, byte pressure))			{ mAfterTouchChannelCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandlePitchBend(void (*fptr)(byte channel, int bend))						{ mPitchBendCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleSystemExclusive(void (*fptr)(byte * array, byte size))				{ mSystemExclusiveCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleTimeCodeQuarterFrame(void (*fptr)(byte data))							{ mTimeCodeQuarterFrameCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleSongPosition(void (*fptr)(unsigned int beats))						{ mSongPositionCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleSongSelect(void (*fptr)(byte songnumber))								{ mSongSelectCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleTuneRequest(void (*fptr)(void))										{ mTuneRequestCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleClock(void (*fptr)(void))												{ mClockCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleStart(void (*fptr)(void))												{ mStartCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleContinue(void (*fptr)(void))											{ mContinueCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleStop(void (*fptr)(void))												{ mStopCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleActiveSensing(void (*fptr)(void))										{ mActiveSensingCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleSystemReset(void (*fptr)(void))										{ mSystemResetCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleConnectionLost(void (*fptr)(void))									{ mConnectionLostCallback = fptr; }
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::setHandleEvent(void (*fptr)(const midievent & event))							{ mEventCallback = fptr; }
+
+
+/*! \brief Detach an external function from the given type.
+
+ Use this method to cancel the effects of setHandle********.
+ \param Type		The type of message to unbind. When a message of this type is received, no function will be called.
+ */
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::disconnectCallbackFromType(kMIDIType Type) {
+
+	switch (Type) {
+		case NoteOff:               mNoteOffCallback = NULL;                break;
+		case NoteOn:                mNoteOnCallback = NULL;                 break;
+		case AfterTouchPoly:        mAfterTouchPolyCallback = NULL;         break;
+		case ControlChange:         mControlChangeCallback = NULL;          break;
+		case ProgramChange:         mProgramChangeCallback = NULL;          break;
+		case AfterTouchChannel:     mAfterTouchChannelCallback = NULL;      break;
+		case PitchBend:             mPitchBendCallback = NULL;              break;
+		case SystemExclusive:       mSystemExclusiveCallback = NULL;        break;
+		case TimeCodeQuarterFrame:  mTimeCodeQuarterFrameCallback = NULL;   break;
+		case SongPosition:          mSongPositionCallback = NULL;           break;
+		case SongSelect:            mSongSelectCallback = NULL;             break;
+		case TuneRequest:           mTuneRequestCallback = NULL;            break;
+		case Clock:                 mClockCallback = NULL;                  break;
+		case Start:                 mStartCallback = NULL;                  break;
+		case Continue:              mContinueCallback = NULL;               break;
+		case Stop:                  mStopCallback = NULL;                   break;
+		case ActiveSensing:         mActiveSensingCallback = NULL;          break;
+		case SystemReset:           mSystemResetCallback = NULL;            break;
+		default:
+			break;
+	}
+
+}
+
+// Protected - launch callback function based on received type.
+template<bool UseStatistics>
+void MIDI_Parser<UseStatistics>::launchCallback() {
+
+	if (mEventCallback != NULL) mEventCallback(makeEvent(mMessage));
+
+	// The order is mixed to allow frequent messages to trigger their callback faster.
+
+	switch (mMessage.type) {
+			// Notes
+		case NoteOff:				if (mNoteOffCallback != NULL)				mNoteOffCallback(mMessage.channel,mMessage.data1,mMessage.data2);	break;
+		case NoteOn:				if (mNoteOnCallback != NULL)				mNoteOnCallback(mMessage.channel,mMessage.data1,mMessage.data2);	break;
+
+			// Real-time messages
+		case Clock:					if (mClockCallback != NULL)					mClockCallback();			break;
+		case Start:					if (mStartCallback != NULL)					mStartCallback();			break;
+		case Continue:				if (mContinueCallback != NULL)				mContinueCallback();		break;
+		case Stop:					if (mStopCallback != NULL)					mStopCallback();			break;
+		case ActiveSensing:			if (mActiveSensingCallback != NULL)			mActiveSensingCallback();	break;
+
+			// Continuous controllers
+		case ControlChange:			if (mControlChangeCallback != NULL)			mControlChangeCallback(mMessage.channel,mMessage.data1,mMessage.data2);	break;
+		case PitchBend:				if (mPitchBendCallback != NULL)				mPitchBendCallback(mMessage.channel,(int)((mMessage.data1 & 0x7F) | ((mMessage.data2 & 0x7F)<< 7)) - 8192);	break; // TODO: check this
+		case AfterTouchPoly:		if (mAfterTouchPolyCallback != NULL)		mAfterTouchPolyCallback(mMessage.channel,mMessage.data1,mMessage.data2);	break;
+		case AfterTouchChannel:		if (mAfterTouchChannelCallback != NULL)		mAfterTouchChannelCallback(mMessage.channel,mMessage.data1);	break;
+
+		case ProgramChange:			if (mProgramChangeCallback != NULL)			mProgramChangeCallback(mMessage.channel,mMessage.data1);	break;
+		case SystemExclusive:		if (mSystemExclusiveCallback != NULL)		mSystemExclusiveCallback(mSysExArray,mMessage.data1);	break;
+
+			// Occasional messages
+		case TimeCodeQuarterFrame:	if (mTimeCodeQuarterFrameCallback != NULL)	mTimeCodeQuarterFrameCallback(mMessage.data1);	break;
+		case SongPosition:			if (mSongPositionCallback != NULL)			mSongPositionCallback((mMessage.data1 & 0x7F) | ((mMessage.data2 & 0x7F)<< 7));	break;
+		case SongSelect:			if (mSongSelectCallback != NULL)			mSongSelectCallback(mMessage.data1);	break;
+		case TuneRequest:			if (mTuneRequestCallback != NULL)			mTuneRequestCallback();	break;
+
+		case SystemReset:			if (mSystemResetCallback != NULL)			mSystemResetCallback();	break;
+		case InvalidType:
+		default:
+			break;
+	}
+
+}
+
+
+/*! \brief Set the filter for thru mirroring
+ \param inThruFilterMode a filter mode
+
+ @see kThruFilterMode
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::setThruFilterMode(kThruFilterMode inThruFilterMode) {
+	mThruFilterMode = inThruFilterMode;
+	if (mThruFilterMode != Off) mThruActivated = Settings::Thru;
+	else mThruActivated = false;
+}
+
+/*! \brief Set the filter for thru mirroring
+ \param inThruFilterMode a filter mode
+
+ This method uses a byte parameter and is for compatibility only, please use kThruFilterMode for future programs.
+ @see kThruFilterMode
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::setThruFilterMode(byte inThruFilterMode) {
+	setThruFilterMode((kThruFilterMode)inThruFilterMode);
+}
+
+
+/*! \brief Setter method: turn message mirroring on. */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::turnThruOn(kThruFilterMode inThruFilterMode) {
+	mThruActivated = Settings::Thru;
+	mThruFilterMode = inThruFilterMode;
+}
+/*! \brief Setter method: turn message mirroring off. */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::turnThruOff() {
+	mThruActivated = false;
+	mThruFilterMode = Off;
+}
+
+/*! \brief Forward the received messages through a MIDI_Router, instead of the Thru filter.
+ \param inRouter	The router, NULL to go back to the Thru filter.
+ \param inPort		The port number of this interface in the router.
+
+ Called by MIDI_Router::setPort(), you don't need to call it yourself.
+ */
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::setRouter(MIDI_Router * inRouter, byte inPort) {
+	mRouter = inRouter;
+	mRouterPort = inPort;
+}
+
+// This method is called upon reception of a message and takes care of Thru filtering and sending.
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::thru_filter(byte inChannel) {
+
+	/*
+	 This method handles Soft-Thru filtering.
+
+	 Soft-Thru filtering:
+	 - All system messages (System Exclusive, Common and Real Time) are passed to output unless filter is set to Off
+	 - Channel messages are passed to the output whether their channel is matching the input channel and the filter setting
+
+	 It is called before the input filter, so the messages of the other channels can be passed (DifferentChannel).
+	 When a router is set, it does the filtering with its routes instead.
+	 */
+
+	// If the feature is disabled, don't do anything.
+	if (!mThruActivated) return;
+
+	if (mRouter != NULL) {
+		mRouter->route(mRouterPort,mMessage.type,mMessage.data1,mMessage.data2,mMessage.channel,mMessageBuffer.sysex_array);
+		return;
+	}
+
+	if (mThruFilterMode == Off) return;
+
+	// Channel messages are filtered on the channel read, as input_filter() does.
+	if (mMessage.type < SystemExclusive) {
+
+		bool filter_condition = ((mMessage.channel == inChannel) || (inChannel == MIDI_CHANNEL_OMNI));
+
+		if (mThruFilterMode == SameChannel && !filter_condition) return;
+		if (mThruFilterMode == DifferentChannel && filter_condition) return;
+	}
+
+	forward(mMessage.type,mMessage.data1,mMessage.data2,mMessage.channel,mMessageBuffer.sysex_array);
+
+}
+
+// Cut-through Thru: called with each received byte before it is parsed, copies it to the output
+// if the message it belongs to passes the Thru filter (see MIDI_DefaultSettings::ThruCutThrough).
+template<class SerialPort, class Settings>
+void MIDI_Interface<SerialPort, Settings>::thru_cut_through(byte inByte, byte inChannel) {
+
+	/*
+	 mThruStatus holds the status of the message being copied, 0 if the current message is filtered out.
+	 The parser state (pending index and running status) tells if a data byte starts a new message.
+	 */
+
+	if (!mThruActivated || (mThruFilterMode == Off) || (mRouter != NULL)) return;
+
+	// Real Time: goes through immediately, even in the middle of a message.
+	if (inByte >= 0xF8) {
+		if (inByte != 0xF9 && inByte != 0xFD) {
+			mSerial.write(inByte);
+			mStatistics.sent((kMIDIType)inByte);
+		}
+		return;
+	}
+
+	// Data byte of the current message (the SysEx continues even if the input buffer overflowed).
+	if (inByte < 0x80 && (this->mPendingMessageIndex != 0 || mThruStatus == SystemExclusive)) {
+		if (mThruStatus != 0) mSerial.write(inByte);
+		return;
+	}
+
+	// From here, a new message starts: the current one is over (or interrupted).
+	const bool interrupted = (mThruStatus != 0) && (this->mPendingMessageIndex != 0);
+
+	// End of Exclusive
+	if (inByte == 0xF7) {
+		if (mThruStatus == SystemExclusive) mSerial.write(inByte);
+		else if (interrupted) mRunningStatus_TX = InvalidType;
+		mThruStatus = 0;
+		return;
+	}
+
+	// The output got an uncompleted message, make sure the next one starts with its status byte.
+	if (interrupted) mRunningStatus_TX = InvalidType;
+	mThruStatus = 0;
+
+	const byte status = (inByte >= 0x80) ? inByte : this->mRunningStatus_RX;	// Data byte: running status
+	const kMIDIType type = Parser::getTypeFromStatusByte(status);
+
+	if (type == InvalidType) return;	// Undefined status or orphan data byte, dropped.
+
+	if (type < SystemExclusive) {
+
+		// Channel messages are filtered on the channel read, as thru_filter() does.
+		const byte channel = (status & 0x0F) + 1;
+		bool filter_condition = ((channel == inChannel) || (inChannel == MIDI_CHANNEL_OMNI));
+
+		if (mThruFilterMode == SameChannel && !filter_condition) return;
+		if (mThruFilterMode == DifferentChannel && filter_condition) return;
+
+		if (status_needed(status)) mSerial.write(status);
+	}
+	else {
+		mRunningStatus_TX = InvalidType;
+		mSerial.write(status);
+	}
+
+	if (inByte < 0x80) mSerial.write(inByte);
+
+	mThruStatus = status;
+	mStatistics.sent(type);
+
+}
+
+
+#endif // LIB_MIDI_CORE_HPP_
@@ -0,0 +1,149 @@
+/*!
+ *  @file		MIDI_Defs.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Shared definitions
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_DEFS_H_
+#define LIB_MIDI_DEFS_H_
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "MIDI_Settings.h"
+
+
+#define MIDI_BAUDRATE			31250
+
+#define MIDI_CHANNEL_OMNI		0
+#define MIDI_CHANNEL_OFF		17 // and over
+
+
+/*! Type definition for practical use (because "unsigned char" is a bit long to write.. )*/
+typedef uint8_t byte;
+
+/*! Enumeration of MIDI types */
+enum kMIDIType {
+	NoteOff	              = 0x80,	///< Note Off
+	NoteOn                = 0x90,	///< Note On
+	AfterTouchPoly        = 0xA0,	///< Polyphonic AfterTouch
+	ControlChange         = 0xB0,	///< Control Change / Channel Mode
+	ProgramChange         = 0xC0,	///< Program Change
+	AfterTouchChannel     = 0xD0,	///< Channel (monophonic) AfterTouch
+	PitchBend             = 0xE0,	///< Pitch Bend
+	SystemExclusive       = 0xF0,	///< System Exclusive
+	TimeCodeQuarterFrame  = 0xF1,	///< System Common - MIDI Time Code Quarter Frame
+	SongPosition          = 0xF2,	///< System Common - Song Position Pointer
+	SongSelect            = 0xF3,	///< System Common - Song Select
+	TuneRequest           = 0xF6,	///< System Common - Tune Request
+	Clock                 = 0xF8,	///< System Real Time - Timing Clock
+	Start                 = 0xFA,	///< System Real Time - Start
+	Continue              = 0xFB,	///< System Real Time - Continue
+	Stop                  = 0xFC,	///< System Real Time - Stop
+	ActiveSensing         = 0xFE,	///< System Real Time - Active Sensing
+	SystemReset           = 0xFF,	///< System Real Time - System Reset
+	InvalidType           = 0x00    ///< For notifying errors
+};
+
+/*! Number of different MIDI types (status byte values): 7 channel types and the 16 system ones. */
+#define MIDI_NUM_TYPE_SLOTS		23
+
+/*! \brief Index of a (valid) MIDI type: 0 to 6 for the channel messages, 7 to 22 for the system ones (0xF0 to 0xFF).
+
+ Used by the per-type tables and bit masks (see MIDI_Statistics and MIDI_Route).
+ */
+static inline byte getTypeSlot(kMIDIType inType) {
+	return (inType < SystemExclusive) ? (((byte)inType >> 4) & 0x07) : 7 + ((byte)inType & 0x0F);
+}
+
+
+/*! Enumeration of Thru filter modes */
+enum kThruFilterMode {
+	Off                   = 0,  ///< Thru disabled (nothing passes through).
+	Full                  = 1,  ///< Fully enabled Thru (every incoming message is sent back).
+	SameChannel           = 2,  ///< Only the messages on the Input Channel will be sent back.
+	DifferentChannel      = 3   ///< All the messages but the ones on the Input Channel will be sent back.
+};
+
+
+/*! Actions on Active Sensing timeout, in addition to the ConnectionLost callback (can be combined). */
+enum kSensingAction {
+	SensingNotify         = 0,  ///< Only call the ConnectionLost callback.
+	SensingSendNotesOff   = 1,  ///< Send All Notes Off on the output, for the channels which received notes.
+	SensingLocalNotesOff  = 2   ///< Return All Notes Off from read() (and their callbacks), for the channels which received notes.
+};
+
+/*! Active Sensing timeout, in milliseconds (MIDI 1.0 specification). */
+#define MIDI_SENSING_TIMEOUT	300
+
+
+/*! \brief The fields of midimsg which don't depend on the SysEx size: what the parser fills, whatever the settings. */
+struct midimsg_header {
+	/*! The MIDI channel on which the message was recieved. \n Value goes from 1 to 16. */
+	byte channel;
+	/*! The type of the message (see the define section for types reference) */
+	kMIDIType type;
+	/*! The first data byte.\n Value goes from 0 to 127.\n If the message is SysEx, this byte contains the array length. */
+	byte data1;
+	/*! The second data byte. If the message is only 2 bytes long, this one is null.\n Value goes from 0 to 127. */
+	byte data2;
+	/*! This boolean indicates if the message is valid or not. There is no channel consideration here, validity means the message respects the MIDI norm. */
+	bool valid;
+};
+
+/*! The midimsg structure contains decoded data of a MIDI message read from the serial port with read() or thru(). \n
+ SysExSize is the size of the System Exclusive array, given by the settings (see MIDI_DefaultSettings::SysExMaxSize).
+ */
+template<unsigned SysExSize>
+struct midimsg : public midimsg_header {
+	/*! System Exclusive dedicated byte array. \n Array length is stocked in data1. */
+	byte sysex_array[SysExSize];
+};
+
+
+/*! \brief A MIDI message in 4 bytes, for the queues, buffers and callbacks (midimsg carries a whole SysEx array).
+
+ The status byte holds the type, and the channel of the channel messages.
+ A SysEx event only holds its length (data1, 0xF0 and 0xF7 included): the
+ bytes stay out of the event, in the interface (getSysExArray()) or in the
+ queue which stored it (see MIDI_EventQueue). setHandleEvent() gives each
+ message received as a midievent, before the callback of its type.
+ */
+struct midievent {
+	/*! Status byte: the type, and the channel - 1 for the channel messages. InvalidType (0) for an invalid message. */
+	byte status;
+	/*! The first data byte.\n For a SysEx, the length of its array. */
+	byte data1;
+	/*! The second data byte. Null for the messages of 2 bytes or less. */
+	byte data2;
+	/*! The port (0 to 15, eg: the input of a merger) in the 4 low bits, the 4 high bits are free for the application. */
+	byte flags;
+
+	kMIDIType getType() const { return (status < 0xF0) ? (kMIDIType)(status & 0xF0) : (kMIDIType)status; }
+	/*! Channel (1 to 16) of a channel message, 0 for the system messages. */
+	byte getChannel() const { return (status >= 0x80 && status < 0xF0) ? (status & 0x0F) + 1 : 0; }
+	byte getPort() const { return flags & 0x0F; }
+};
+
+/*! \brief Pack a message into a midievent. A channel message with a channel out of 1 to 16 gives an InvalidType event. */
+static inline midievent makeEvent(kMIDIType inType, byte inData1, byte inData2, byte inChannel, byte inPort = 0) {
+	midievent event;
+	if (inType >= 0x80 && inType < SystemExclusive) event.status = (inChannel >= 1 && inChannel <= 16) ? inType | (inChannel - 1) : InvalidType;
+	else event.status = inType;
+	event.data1 = inData1;
+	event.data2 = inData2;
+	event.flags = inPort & 0x0F;
+	return event;
+}
+
+/*! \brief Pack a received message into a midievent (without the SysEx array), eg: MIDI.getMessage(). */
+static inline midievent makeEvent(const midimsg_header & inMessage, byte inPort = 0) {
+	return makeEvent(inMessage.valid ? inMessage.type : InvalidType,inMessage.data1,inMessage.data2,inMessage.channel,inPort);
+}
+
+
+#endif // LIB_MIDI_DEFS_H_
@@ -0,0 +1,136 @@
+/*!
+ *  @file		MIDI_Events.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Queue of compact MIDI events
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_EVENTS_H_
+#define LIB_MIDI_EVENTS_H_
+
+#include "MIDI_Defs.h"
+#include "MIDI_Time.h"
+
+
+/*! \brief FIFO of midievent (4 bytes each), the SysEx bytes in a ring buffer of their own.
+
+ One writer and one reader, which can be an interrupt: eg: messages pushed
+ by a USB or timer interrupt, and popped in loop(). A SysEx is stored whole
+ or not at all; with SysExSize = 0, the SysEx are refused. The queue of 32
+ events and 128 SysEx bytes takes about the room of one midimsg.
+ \code
+ MIDI_EventQueue<32,128> queue;
+
+ void loop() {
+ 	if (MIDI.read()) queue.push(MIDI.getMessage());
+
+ 	midievent event;
+ 	byte sysex[128];
+ 	while (queue.pop(event,sysex)) MIDI.forward(event,sysex);
+ }
+ \endcode
+ */
+template<byte Size = 32, unsigned SysExSize = 0>
+class MIDI_EventQueue {
+
+public:
+
+	MIDI_EventQueue() { clear(); }
+
+	/*! \brief Remove all the events. Not to be called while the other side (writer or reader) is running. */
+	void clear() {
+		MIDI_ATOMIC_BEGIN
+		mHead = mTail = mCount = 0;
+		mSysExHead = mSysExTail = mSysExCount = 0;
+		mDropped = 0;
+		MIDI_ATOMIC_END
+	}
+
+	/*! \brief Add an event, and the bytes of a SysEx (inEvent.data1 bytes). Returns false if there is no room (dropped). */
+	bool push(const midievent & inEvent, const byte * inSysEx = NULL) {
+
+		const bool sysex = (inEvent.status == SystemExclusive);
+		const unsigned length = sysex ? inEvent.data1 : 0;
+
+		unsigned free;
+		MIDI_ATOMIC_BEGIN
+		free = SysExSize - mSysExCount;
+		MIDI_ATOMIC_END
+
+		if (mCount >= Size || (sysex && (inSysEx == NULL || length > free))) {
+			mDropped++;
+			return false;
+		}
+
+		for (unsigned i=0;i<length;i++) {
+			mSysEx[mSysExTail] = inSysEx[i];
+			if (++mSysExTail >= SysExSize) mSysExTail = 0;
+		}
+		mQueue[mTail] = inEvent;
+		if (++mTail >= Size) mTail = 0;
+
+		MIDI_ATOMIC_BEGIN
+		mSysExCount += length;
+		mCount++;
+		MIDI_ATOMIC_END
+		return true;
+	}
+
+	/*! \brief Add a received message, eg: MIDI.getMessage(). */
+	template<unsigned MessageSysExSize>
+	bool push(const midimsg<MessageSysExSize> & inMessage, byte inPort = 0) {
+		return push(makeEvent(inMessage,inPort),inMessage.sysex_array);
+	}
+
+	/*! \brief Take the oldest event, returns false if the queue is empty.
+	 \param outSysEx	Receives the bytes of a SysEx (outEvent.data1 bytes), or NULL to discard them.
+	 */
+	bool pop(midievent & outEvent, byte * outSysEx = NULL) {
+
+		if (mCount == 0) return false;
+
+		outEvent = mQueue[mHead];
+		if (++mHead >= Size) mHead = 0;
+
+		const unsigned length = (outEvent.status == SystemExclusive) ? outEvent.data1 : 0;
+		for (unsigned i=0;i<length;i++) {
+			if (outSysEx != NULL) outSysEx[i] = mSysEx[mSysExHead];
+			if (++mSysExHead >= SysExSize) mSysExHead = 0;
+		}
+
+		MIDI_ATOMIC_BEGIN
+		mSysExCount -= length;
+		mCount--;
+		MIDI_ATOMIC_END
+		return true;
+	}
+
+	/*! \brief The oldest event, without removing it (check isEmpty() first). */
+	const midievent & peek() const { return mQueue[mHead]; }
+
+	byte getCount() const { return mCount; }
+	bool isEmpty() const { return mCount == 0; }
+	bool isFull() const { return mCount >= Size; }
+
+	/*! \brief Number of events refused since clear(), the queue being full. */
+	unsigned int getDropped() const { return mDropped; }
+
+private:
+
+	midievent		mQueue[Size];
+	byte			mSysEx[SysExSize ? SysExSize : 1];
+	byte			mHead;			// Oldest event, moved by the reader
+	byte			mTail;			// Next free slot, moved by the writer
+	volatile byte	mCount;
+	unsigned		mSysExHead;
+	unsigned		mSysExTail;
+	volatile unsigned	mSysExCount;
+	unsigned int	mDropped;
+
+};
+
+
+#endif // LIB_MIDI_EVENTS_H_
@@ -0,0 +1,579 @@
+/*!
+ *  @file		MIDI_File.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Standard MIDI File (SMF) streaming player and recorder
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_FILE_H_
+#define LIB_MIDI_FILE_H_
+
+#include "MIDI_Defs.h"
+#include "MIDI_Time.h"
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#endif
+
+
+/*
+ Byte sources of the MIDI_FilePlayer: any class with
+ int read(unsigned long inOffset), returning the byte at inOffset in the file,
+ or -1 past its end (or on error).
+ */
+
+/*! \brief File stored in RAM (or a host buffer). */
+class MIDI_FileArray {
+
+public:
+
+	MIDI_FileArray(const byte * inData, unsigned long inSize) : mData(inData), mSize(inSize) { }
+
+	int read(unsigned long inOffset) const { return (inOffset < mSize) ? mData[inOffset] : -1; }
+
+private:
+
+	const byte *	mData;
+	unsigned long	mSize;
+
+};
+
+#if defined(__AVR__)
+/*! \brief File stored in the program memory (PROGMEM array). */
+class MIDI_FileProgmem {
+
+public:
+
+	MIDI_FileProgmem(const prog_uchar * inData, unsigned long inSize) : mData(inData), mSize(inSize) { }
+
+	int read(unsigned long inOffset) const { return (inOffset < mSize) ? pgm_read_byte(mData + inOffset) : -1; }
+
+private:
+
+	const prog_uchar *	mData;
+	unsigned long		mSize;
+
+};
+#endif
+
+/*! \brief File read from a stream with seek(unsigned long) and read(), like the SD library File.
+
+ The stream is only moved when the tracks are read in another place than the
+ current position: the tracks of a format 1 file are read in turn, give it a
+ buffered stream (the SD library caches a block).
+ */
+template<class Stream>
+class MIDI_FileStream {
+
+public:
+
+	MIDI_FileStream(Stream & inStream) : mStream(inStream), mPosition(0xFFFFFFFF) { }
+
+	int read(unsigned long inOffset) {
+		if (inOffset != mPosition) {
+			if (!mStream.seek(inOffset)) return -1;
+			mPosition = inOffset;
+		}
+		const int c = mStream.read();
+		if (c >= 0) mPosition++;
+		return c;
+	}
+
+private:
+
+	Stream &		mStream;
+	unsigned long	mPosition;
+
+};
+
+
+/*! \brief Standard MIDI File player: reads the events of a format 0 or 1 file as they are needed, and schedules them.
+
+ The file is never loaded: each track keeps its position in the file and the
+ time of its next event (18 bytes of RAM per track on AVR, up to MaxTracks), and
+ the tracks are merged in time order with a heap. update() schedules the
+ events due in the next getLookAhead() microseconds to the Output, a
+ MIDI_Scheduler, which sends them on time, eg: from a timer interrupt.
+ \code
+ MIDI_Scheduler<MIDI_Class,32> scheduler(MIDI);
+ MIDI_FileProgmem song(songData,sizeof(songData));
+ MIDI_FilePlayer<MIDI_FileProgmem, MIDI_Scheduler<MIDI_Class,32> > player(song,scheduler);
+
+ void setup() {
+ 	MIDI.begin();
+ 	if (player.open()) player.play(micros());
+ }
+
+ void loop() {
+ 	player.update(micros());
+ 	scheduler.dispatch();
+ }
+ \endcode
+ Tempo changes and SMPTE time divisions are supported. SysEx and meta events
+ (other than tempo and end of track) are skipped: MIDI_Scheduler can't send
+ SysEx.
+ */
+template<class Source, class Output, byte MaxTracks = 8>
+class MIDI_FilePlayer {
+
+public:
+
+	MIDI_FilePlayer(Source & inSource, Output & inOutput) : mSource(inSource), mOutput(inOutput), mNumTracks(0), mHeapSize(0), mDivision(0), mTickPeriod(1), mTick(0), mTime(0), mFraction(0), mPlaying(false), mLookAhead(20000) { }
+
+	/*! \brief Read the header and find the tracks. Returns false if it is not a format 0 or 1 MIDI file. */
+	bool open() {
+
+		mPlaying = false;
+		mNumTracks = 0;
+
+		// Header chunk: "MThd", length, format, number of tracks, division.
+		if (read32(0) != 0x4D546864UL) return false;
+		const unsigned long header_length = read32(4);
+		const uint16_t format = read16(8);
+		const uint16_t tracks = read16(10);
+		mDivision = read16(12);
+		if (header_length < 6 || format > 1 || mDivision == 0) return false;
+
+		// Track chunks: "MTrk" and length, other chunks are skipped.
+		unsigned long offset = 8 + header_length;
+		for (uint16_t t=0;t<tracks && mNumTracks<MaxTracks;) {
+			const unsigned long id = read32(offset);
+			const unsigned long length = read32(offset + 4);
+			if (mSource.read(offset + 7) < 0) break;	// Truncated file
+			if (id == 0x4D54726BUL) {
+				mTracks[mNumTracks].start = offset + 8;
+				mTracks[mNumTracks].end = offset + 8 + length;
+				mNumTracks++;
+				t++;
+			}
+			offset += 8 + length;
+		}
+
+		rewind();
+		return mNumTracks > 0;
+	}
+
+	/*! \brief Go back to the beginning of the file. */
+	void rewind() {
+
+		mHeapSize = 0;
+		for (byte i=0;i<mNumTracks;i++) {
+			Track & track = mTracks[i];
+			track.offset = track.start;
+			track.tick = 0;
+			track.status = 0;
+			if (read_delta(track)) push(i);
+		}
+
+		mTick = 0;
+		mFraction = 0;
+		if (mDivision & 0x8000) {
+			// SMPTE: frames per second (negative, -29 is 29.97) x ticks per frame.
+			const byte fps = -(signed char)(mDivision >> 8);
+			const byte ticks = mDivision & 0xFF;
+			mTickPeriod = ((fps == 29) ? 8541875UL : 256000000UL / fps) / (ticks ? ticks : 1);
+		}
+		else setTempo(500000);	// 120 BPM
+	}
+
+	/*! \brief Start playing, the current position of the file is played at inNow. */
+	void play(unsigned long inNow) {
+		mTime = inNow;
+		mFraction = 0;
+		mPlaying = true;
+	}
+
+	/*! \brief Stop scheduling the events (the ones already scheduled are not removed). */
+	void stop() { mPlaying = false; }
+
+	bool isPlaying() const { return mPlaying; }
+
+	/*! \brief True when all the tracks were played. */
+	bool isFinished() const { return mHeapSize == 0; }
+
+	/*! \brief Current position in the file, in ticks (see getDivision()). */
+	unsigned long getTick() const { return mTick; }
+
+	/*! \brief Time division of the file header: ticks per quarter note, or SMPTE format if the bit 15 is set. */
+	uint16_t getDivision() const { return mDivision; }
+
+	/*! \brief Schedule the events up to inLookAhead us in advance (20 ms by default). */
+	void setLookAhead(unsigned long inLookAhead) { mLookAhead = inLookAhead; }
+	unsigned long getLookAhead() const { return mLookAhead; }
+
+	/*! \brief Schedule the events due before inNow + getLookAhead(), as long as the output has room. Call it in loop(). */
+	void update(unsigned long inNow) {
+
+		while (mPlaying && mHeapSize > 0 && mOutput.getFree() > 0) {
+
+			Track & track = mTracks[mHeap[0]];
+
+			// Time of the next event, from the time of the current position.
+			unsigned long time = mTime;
+			byte fraction = mFraction;
+			advance(track.tick - mTick,time,fraction);
+			if ((long)(time - (inNow + mLookAhead)) > 0) return;
+
+			mTick = track.tick;
+			mTime = time;
+			mFraction = fraction;
+
+			play_event(track);
+
+			if (read_delta(track)) sift_down(0);
+			else pop();
+		}
+	}
+
+private:
+
+	struct Track {
+		unsigned long	start;
+		unsigned long	end;
+		unsigned long	offset;		// Next byte to read
+		unsigned long	tick;		// Time of the next event
+		byte			status;		// Running status
+	};
+
+	// Big endian integers and variable length quantities
+	unsigned long read32(unsigned long inOffset) { return ((unsigned long)read16(inOffset) << 16) | read16(inOffset + 2); }
+	uint16_t read16(unsigned long inOffset) { return ((uint16_t)read_byte(inOffset) << 8) | read_byte(inOffset + 1); }
+	byte read_byte(unsigned long inOffset) { const int c = mSource.read(inOffset); return (c < 0) ? 0 : (byte)c; }
+
+	unsigned long read_vlq(Track & inTrack) {
+		unsigned long value = 0;
+		for (byte i=0;i<4 && inTrack.offset < inTrack.end;i++) {
+			const byte c = read_byte(inTrack.offset++);
+			value = (value << 7) | (c & 0x7F);
+			if (!(c & 0x80)) break;
+		}
+		return value;
+	}
+
+	// Read the delta time of the next event, returns false at the end of the track.
+	bool read_delta(Track & inTrack) {
+		if (inTrack.offset >= inTrack.end) return false;
+		inTrack.tick += read_vlq(inTrack);
+		return inTrack.offset < inTrack.end;
+	}
+
+	// Read the event at the position of the track, and schedule it.
+	void play_event(Track & inTrack) {
+
+		byte status = read_byte(inTrack.offset);
+		byte data1;
+
+		if (status < 0x80) {
+			status = inTrack.status;
+			if (status == 0) {		// Data without running status: skip the byte.
+				inTrack.offset++;
+				return;
+			}
+		}
+		else inTrack.offset++;
+
+		if (status < 0xF0) {
+			inTrack.status = status;
+			data1 = read_byte(inTrack.offset++);
+			const byte type = status & 0xF0;
+			const byte data2 = (type == ProgramChange || type == AfterTouchChannel) ? 0 : read_byte(inTrack.offset++);
+			mOutput.schedule(mTime,(kMIDIType)type,data1 & 0x7F,data2 & 0x7F,(status & 0x0F) + 1);
+			return;
+		}
+
+		// SysEx and meta events cancel the running status.
+		inTrack.status = 0;
+
+		if (status == 0xFF) {
+			const byte meta = read_byte(inTrack.offset++);
+			const unsigned long length = read_vlq(inTrack);
+			if (meta == 0x51 && length == 3 && !(mDivision & 0x8000)) {
+				setTempo(((unsigned long)read_byte(inTrack.offset) << 16) | ((unsigned long)read_byte(inTrack.offset + 1) << 8) | read_byte(inTrack.offset + 2));
+			}
+			else if (meta == 0x2F) {
+				inTrack.offset = inTrack.end;	// End of track
+				return;
+			}
+			inTrack.offset += length;
+		}
+		else if (status == 0xF0 || status == 0xF7) {
+			inTrack.offset += read_vlq(inTrack);
+		}
+		else inTrack.offset = inTrack.end;		// Invalid event: the rest of the track can't be decoded.
+	}
+
+	// Tempo in microseconds per quarter note.
+	void setTempo(unsigned long inTempo) {
+		mTickPeriod = ((inTempo << 8) + mDivision / 2) / mDivision;
+		if (mTickPeriod == 0) mTickPeriod = 1;
+	}
+
+	// Time after inTicks, in us and 1/256 us (exact modulo 2^32 us, as the times wrap around).
+	void advance(unsigned long inTicks, unsigned long & ioTime, byte & ioFraction) const {
+		const unsigned long low = mTickPeriod & 0xFF;
+		const unsigned long fraction = (inTicks & 0xFF) * low + ioFraction;
+		ioTime += inTicks * (mTickPeriod >> 8) + (inTicks >> 8) * low + (fraction >> 8);
+		ioFraction = fraction & 0xFF;
+	}
+
+	// Min-heap of the tracks, by time of the next event (then track number, to keep the file order).
+	bool is_before(byte inA, byte inB) const {
+		const unsigned long a = mTracks[inA].tick, b = mTracks[inB].tick;
+		return (a < b) || (a == b && inA < inB);
+	}
+
+	void push(byte inTrack) {
+		byte i = mHeapSize++;
+		while (i > 0) {
+			const byte parent = (i - 1) / 2;
+			if (!is_before(inTrack,mHeap[parent])) break;
+			mHeap[i] = mHeap[parent];
+			i = parent;
+		}
+		mHeap[i] = inTrack;
+	}
+
+	void pop() {
+		mHeap[0] = mHeap[--mHeapSize];
+		if (mHeapSize > 0) sift_down(0);
+	}
+
+	void sift_down(byte i) {
+		const byte track = mHeap[i];
+		for (;;) {
+			byte child = 2 * i + 1;
+			if (child >= mHeapSize) break;
+			if (child + 1 < mHeapSize && is_before(mHeap[child + 1],mHeap[child])) child++;
+			if (!is_before(mHeap[child],track)) break;
+			mHeap[i] = mHeap[child];
+			i = child;
+		}
+		mHeap[i] = track;
+	}
+
+	Source &		mSource;
+	Output &		mOutput;
+
+	Track			mTracks[MaxTracks];
+	byte			mNumTracks;
+	byte			mHeap[MaxTracks];
+	byte			mHeapSize;
+
+	uint16_t		mDivision;
+	unsigned long	mTickPeriod;	// In 1/256 us
+	unsigned long	mTick;			// Position of the last event played
+	unsigned long	mTime;			// Time of the last event played, in us
+	byte			mFraction;		// and 1/256 us
+
+	bool			mPlaying;
+	unsigned long	mLookAhead;
+
+};
+
+
+/*! \brief Standard MIDI File recorder: writes the received messages to a format 0 file, as they come.
+
+ The events are encoded (delta time, running status) into two blocks of
+ BlockSize bytes: when one is full, update() writes it to the Sink while the
+ other one is filled, so record() never waits for the Sink. The Sink is any
+ class with write(const byte *, unsigned) and seek(unsigned long), like the
+ SD library File. An event which doesn't fit in the free blocks (update() not
+ called often enough) is dropped, see getDropped(). A SysEx is never dropped:
+ when it is longer than the free room, record() writes the full blocks to
+ the Sink while encoding it, and waits for it.
+ \code
+ File file = SD.open("take.mid",FILE_WRITE);
+ MIDI_FileRecorder<File,512> recorder(file);
+
+ void setup() {
+ 	MIDI.begin(MIDI_CHANNEL_OMNI);
+ 	recorder.begin();
+ }
+
+ void loop() {
+ 	if (MIDI.read()) recorder.record(MIDI.getMessage());
+ 	recorder.update();
+ 	if (stopButton()) { recorder.end(); file.close(); }
+ }
+ \endcode
+ Times are in milliseconds (MIDI_MILLIS() by default): the file has 500 ticks
+ per quarter note at 120 BPM, a tick per millisecond. System Common messages
+ are written as escaped events (F7), Real Time messages are not recorded.
+ */
+template<class Sink, unsigned BlockSize = 64>
+class MIDI_FileRecorder {
+
+public:
+
+	MIDI_FileRecorder(Sink & inSink) : mSink(inSink), mRecording(false), mDropped(0) { }
+
+	/*! \brief Write the header and start recording, inNow is the time of the start of the file. */
+	bool begin(unsigned long inNow) {
+
+		static const byte header[] = {
+			'M','T','h','d', 0,0,0,6, 0,0, 0,1, 0x01,0xF4,		// Format 0, 1 track, 500 ticks per quarter note
+			'M','T','r','k', 0,0,0,0,							// Length, written by end()
+			0x00, 0xFF,0x51,0x03, 0x07,0xA1,0x20				// Tempo: 500000 us per quarter note
+		};
+
+		mActive = 0;
+		mFill = 0;
+		mPending = false;
+		mLength = 0;
+		mRunningStatus = 0;
+		mLastTime = inNow;
+		mDropped = 0;
+
+		if (!mSink.seek(0) || mSink.write(header,TrackHeader) != TrackHeader) return false;
+		for (byte i=TrackHeader;i<sizeof(header);i++) put(header[i]);
+		mRecording = true;
+		return true;
+	}
+
+	bool begin() { return begin(MIDI_MILLIS()); }
+
+	/*! \brief Record a message received at inNow (ms). Returns false if it was dropped. */
+	bool record(kMIDIType inType, byte inData1, byte inData2, byte inChannel, const byte * inSysEx, unsigned long inNow) {
+
+		if (!mRecording || inType == InvalidType || inType >= Clock) return false;
+
+		// Room needed: delta time (4) and the event. A longer SysEx is split by put().
+		if (inType != SystemExclusive && 4 + 3 > getRoom()) {
+			mDropped++;
+			return false;
+		}
+
+		put_vlq(inNow - mLastTime);
+		mLastTime = inNow;
+
+		if (inType < SystemExclusive) {
+			const byte status = inType | ((inChannel - 1) & 0x0F);
+			if (status != mRunningStatus) put(status);
+			mRunningStatus = status;
+			put(inData1 & 0x7F);
+			if (inType != ProgramChange && inType != AfterTouchChannel) put(inData2 & 0x7F);
+			return true;
+		}
+
+		mRunningStatus = 0;		// SysEx and escaped events cancel the running status.
+
+		if (inType == SystemExclusive) {
+			// The array holds F0 ... F7, the F0 is the event type.
+			const byte length = (inData1 > 0) ? inData1 - 1 : 0;
+			put(0xF0);
+			put_vlq(length);
+			for (byte i=0;i<length;i++) put(inSysEx[i + 1]);
+			return true;
+		}
+
+		// System Common: escaped (F7 length bytes).
+		const byte length = (inType == SongPosition) ? 3 : (inType == TuneRequest) ? 1 : 2;
+		put(0xF7);
+		put(length);
+		put(inType);
+		if (length > 1) put(inData1 & 0x7F);
+		if (length > 2) put(inData2 & 0x7F);
+		return true;
+	}
+
+	/*! \brief Record a message received at inNow (ms), eg: MIDI.getMessage(). */
+	template<unsigned SysExSize>
+	bool record(const midimsg<SysExSize> & inMessage, unsigned long inNow) {
+		return record(inMessage.type,inMessage.data1,inMessage.data2,inMessage.channel,inMessage.sysex_array,inNow);
+	}
+
+	/*! \brief Record a message received now (MIDI_MILLIS()), eg: MIDI.getMessage(). */
+	template<unsigned SysExSize>
+	bool record(const midimsg<SysExSize> & inMessage) { return record(inMessage,MIDI_MILLIS()); }
+
+	/*! \brief Record an event at inNow (ms), eg: from a MIDI_EventQueue. inSysEx holds the bytes of a SysEx event. */
+	bool record(const midievent & inEvent, const byte * inSysEx, unsigned long inNow) {
+		if (inEvent.status == SystemExclusive && inSysEx == NULL) return false;
+		return record(inEvent.getType(),inEvent.data1,inEvent.data2,inEvent.getChannel(),inSysEx,inNow);
+	}
+
+	/*! \brief Write the full block to the Sink, if any. Call it in loop(). */
+	void update() {
+		if (!mPending) return;
+		if (mSink.write(mBlocks[mActive ^ 1],BlockSize) != BlockSize) mRecording = false;
+		mPending = false;
+	}
+
+	/*! \brief Stop recording: write the end of the track and the remaining data, and the length of the track. */
+	bool end(unsigned long inNow) {
+
+		if (!mRecording) return false;
+
+		update();
+		if (getRoom() < 8) return false;
+		put_vlq(inNow - mLastTime);
+		put(0xFF);
+		put(0x2F);
+		put(0x00);
+		update();
+		mRecording = false;
+
+		if (mFill > 0 && mSink.write(mBlocks[mActive],mFill) != mFill) return false;
+
+		const byte length[4] = { (byte)(mLength >> 24), (byte)(mLength >> 16), (byte)(mLength >> 8), (byte)mLength };
+		return mSink.seek(TrackHeader - 4) && mSink.write(length,4) == 4;
+	}
+
+	bool end() { return end(MIDI_MILLIS()); }
+
+	bool isRecording() const { return mRecording; }
+
+	/*! \brief Number of events dropped because the blocks were full. */
+	unsigned long getDropped() const { return mDropped; }
+
+private:
+
+	enum { TrackHeader = 22 };	// Header chunk and track chunk header
+
+	// Free bytes: the rest of the active block, and the other one if it was written.
+	// The last byte is kept: filling it switches to the other block, which must be written.
+	unsigned getRoom() const { return (mPending ? BlockSize : 2 * BlockSize) - mFill - 1; }
+
+	void put(byte inByte) {
+		mBlocks[mActive][mFill++] = inByte;
+		mLength++;
+		if (mFill == BlockSize) {
+			update();		// The other block is still full: only for a SysEx longer than the room.
+			mPending = true;
+			mActive ^= 1;
+			mFill = 0;
+		}
+	}
+
+	void put_vlq(unsigned long inValue) {
+		if (inValue > 0x0FFFFFFF) inValue = 0x0FFFFFFF;
+		byte bytes[4];
+		byte n = 0;
+		do {
+			bytes[n++] = inValue & 0x7F;
+			inValue >>= 7;
+		} while (inValue);
+		while (n > 1) put(bytes[--n] | 0x80);
+		put(bytes[0]);
+	}
+
+	Sink &			mSink;
+
+	byte			mBlocks[2][BlockSize];
+	byte			mActive;		// Block being filled
+	unsigned		mFill;
+	bool			mPending;		// The other block is full, to write.
+
+	bool			mRecording;
+	unsigned long	mLength;		// Length of the track
+	byte			mRunningStatus;
+	unsigned long	mLastTime;
+	unsigned long	mDropped;
+
+};
+
+
+#endif // LIB_MIDI_FILE_H_
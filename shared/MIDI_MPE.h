@@ -0,0 +1,572 @@
+/*!
+ *  @file		MIDI_MPE.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - MIDI Polyphonic Expression (MPE) zones, sender and reader
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_MPE_H_
+#define LIB_MIDI_MPE_H_
+
+#include "MIDI_Defs.h"
+
+
+/*! The two MPE zones. */
+enum kMPEZone {
+	MPELowerZone	= 0,	///< Manager channel 1, member channels from 2 upwards
+	MPEUpperZone	= 1,	///< Manager channel 16, member channels from 15 downwards
+	MPENoZone		= 0xFF	///< Channel out of the zones
+};
+
+
+/*! \brief Layout of the MPE zones: number of member channels of the lower and upper zones.
+
+ A zone has a manager channel (1 or 16, zone-wide messages) and 1 to 15
+ member channels (a note per channel, with its own pitch bend, pressure and
+ timbre). When a zone grows over the other, the other one shrinks, or is
+ removed if nothing is left for it, as with the MPE Configuration Message.
+ */
+class MIDI_MPEZones {
+
+public:
+
+	MIDI_MPEZones() { mMembers[MPELowerZone] = mMembers[MPEUpperZone] = 0; }
+
+	/*! \brief Set the number of member channels of a zone (kMPEZone), 0 to remove it. */
+	void set(byte inZone, byte inMembers) {
+		inZone &= 0x01;
+		if (inMembers > 15) inMembers = 15;
+		mMembers[inZone] = inMembers;
+		byte & other = mMembers[inZone ^ 0x01];
+		if (inMembers != 0 && other != 0 && inMembers + other > 14) other = (inMembers >= 14) ? 0 : 14 - inMembers;
+	}
+
+	/*! \brief Number of member channels of a zone (kMPEZone), 0 if the zone is not used. */
+	byte getMembers(byte inZone) const { return mMembers[inZone & 0x01]; }
+
+	/*! \brief Manager channel of a zone (kMPEZone): 1 or 16. */
+	static byte getManagerChannel(byte inZone) { return (inZone & 0x01) ? 16 : 1; }
+
+	/*! \brief Channel (1 to 16) of a member (0 to getMembers() - 1) of a zone. */
+	static byte getMemberChannel(byte inZone, byte inIndex) { return (inZone & 0x01) ? 15 - inIndex : 2 + inIndex; }
+
+	/*! \brief Zone of a channel (1 to 16): MPELowerZone, MPEUpperZone or MPENoZone. */
+	byte getZone(byte inChannel) const {
+		if (mMembers[MPELowerZone] != 0 && inChannel >= 1 && inChannel <= 1 + mMembers[MPELowerZone]) return MPELowerZone;
+		if (mMembers[MPEUpperZone] != 0 && inChannel <= 16 && inChannel >= 16 - mMembers[MPEUpperZone]) return MPEUpperZone;
+		return MPENoZone;
+	}
+
+	/*! \brief Check if a channel (1 to 16) is the manager channel of a zone in use. */
+	bool isManager(byte inChannel) const {
+		return (inChannel == 1 && mMembers[MPELowerZone] != 0) || (inChannel == 16 && mMembers[MPEUpperZone] != 0);
+	}
+
+private:
+
+	byte	mMembers[2];
+
+};
+
+
+/*! \brief MPE output: configuration of the zones, and a member channel for each note.
+
+ The channels are allocated in constant time: a free channel, the one
+ released the longest ago (its release tail is over first), or when all
+ the channels are busy, the next one in turn, shared with the note on it.
+ The expression of a note goes to its channel, only when it changed.
+ \code
+ MIDI_MPESender<MIDI_Interface<HardwareSerial> > mpe(MIDI);
+
+ mpe.configure(MPELowerZone,15);
+ mpe.noteOn(60,100,MPELowerZone);
+ mpe.pitchBend(60,8192 + 1024,MPELowerZone);	// Half a semitone up (48 semitones range)
+ mpe.noteOff(60,0,MPELowerZone);
+ \endcode
+ The zone-wide messages go to the manager channel, through the interface:
+ MIDI.sendPitchBend(value,MIDI_MPEZones::getManagerChannel(MPELowerZone)).
+ */
+template<class Interface>
+class MIDI_MPESender {
+
+public:
+
+	MIDI_MPESender(Interface & inInterface) : mInterface(inInterface) { reset(); }
+
+	/*! \brief Forget the notes and the values sent (the zones are kept). Nothing is sent. */
+	void reset() {
+		for (byte i=0;i<128;i++) mNoteChannels[i] = 0;
+		for (byte c=0;c<16;c++) {
+			mActive[c] = 0;
+			mBend[c] = NoBend;
+			mPressure[c] = NoValue;
+			mTimbre[c] = NoValue;
+		}
+		init_allocator(MPELowerZone);
+		init_allocator(MPEUpperZone);
+	}
+
+	/*! \brief Set up a zone and send its MPE Configuration Message (RPN 6).
+	 \param inZone		MPELowerZone or MPEUpperZone.
+	 \param inMembers	Number of member channels (1 to 15), 0 to remove the zone.
+	 \param inBendRange	Pitch bend range of the member channels, in semitones: sent when not the default 48.
+
+	 The notes held in the zones changed are released first. The receivers
+	 apply the range to all the member channels: it is sent on the first one.
+	 */
+	void configure(byte inZone, byte inMembers, byte inBendRange = 48) {
+
+		inZone &= 0x01;
+		const byte before[2] = { mZones.getMembers(MPELowerZone), mZones.getMembers(MPEUpperZone) };
+		mZones.set(inZone,inMembers);
+		for (byte z=0;z<2;z++) {
+			if (mZones.getMembers(z) == before[z] && z != inZone) continue;
+			release_zone(z,before[z]);
+			init_allocator(z);
+		}
+
+		const byte manager = MIDI_MPEZones::getManagerChannel(inZone);
+		send_rpn(6,mZones.getMembers(inZone),manager);
+		if (mZones.getMembers(inZone) != 0 && inBendRange != 48) {
+			send_rpn(0,inBendRange,MIDI_MPEZones::getMemberChannel(inZone,0));
+		}
+	}
+
+	/*! \brief The zones configured. */
+	const MIDI_MPEZones & getZones() const { return mZones; }
+
+	/*! \brief Send a Note On on a member channel of a zone, with the initial expression of the note.
+	 \param inBend		Initial pitch bend (0 to 16383, center 8192).
+	 \param inPressure	Initial pressure (channel AfterTouch).
+	 \param inTimbre	Initial timbre (CC 74).
+	 Returns the channel of the note, 0 if the zone is not configured.
+	 The expression is sent before the note, when the channel doesn't have it already.
+	 */
+	byte noteOn(byte inNote, byte inVelocity, byte inZone, unsigned int inBend = 8192, byte inPressure = 0, byte inTimbre = 64) {
+
+		inZone &= 0x01;
+		inNote &= 0x7F;
+		if (mZones.getMembers(inZone) == 0) return 0;
+		if (get_index(inNote,inZone) != 0) noteOff(inNote,0,inZone);		// Retriggered
+
+		const byte index = allocate(inZone);
+		const byte channel = MIDI_MPEZones::getMemberChannel(inZone,index);
+		set_index(inNote,inZone,index + 1);
+		mActive[channel - 1]++;
+
+		send_bend(inBend,channel);
+		send_pressure(inPressure,channel);
+		send_timbre(inTimbre,channel);
+		mInterface.sendNoteOn(inNote,inVelocity,channel);
+		return channel;
+	}
+
+	/*! \brief Send a Note Off for a note of a zone, and release its channel. Returns the channel, 0 if the note is not on. */
+	byte noteOff(byte inNote, byte inVelocity, byte inZone) {
+
+		inZone &= 0x01;
+		inNote &= 0x7F;
+		const byte index = get_index(inNote,inZone);
+		if (index == 0) return 0;
+
+		const byte channel = MIDI_MPEZones::getMemberChannel(inZone,index - 1);
+		set_index(inNote,inZone,0);
+		if (--mActive[channel - 1] == 0) free_channel(inZone,index - 1);
+		mInterface.sendNoteOff(inNote,inVelocity,channel);
+		return channel;
+	}
+
+	/*! \brief Send the pitch bend of a note (0 to 16383, center 8192). */
+	void pitchBend(byte inNote, unsigned int inBend, byte inZone) {
+		const byte channel = getChannel(inNote,inZone);
+		if (channel != 0) send_bend(inBend,channel);
+	}
+
+	/*! \brief Send the pressure of a note (channel AfterTouch on its channel). */
+	void pressure(byte inNote, byte inPressure, byte inZone) {
+		const byte channel = getChannel(inNote,inZone);
+		if (channel != 0) send_pressure(inPressure,channel);
+	}
+
+	/*! \brief Send the timbre of a note (CC 74 on its channel). */
+	void timbre(byte inNote, byte inTimbre, byte inZone) {
+		const byte channel = getChannel(inNote,inZone);
+		if (channel != 0) send_timbre(inTimbre,channel);
+	}
+
+	/*! \brief Channel of a note of a zone, 0 if the note is not on. */
+	byte getChannel(byte inNote, byte inZone) const {
+		const byte index = get_index(inNote & 0x7F,inZone & 0x01);
+		return (index == 0) ? 0 : MIDI_MPEZones::getMemberChannel(inZone,index - 1);
+	}
+
+private:
+
+	enum {
+		NoBend = 0xFFFF,
+		NoValue = 0xFF
+	};
+
+	// Free member channels of a zone: a queue, the ones released the longest ago first.
+	struct Allocator {
+		byte	free[15];
+		byte	head;
+		byte	count;
+		byte	next;		// Next member shared when none is free
+	};
+
+	byte get_index(byte inNote, byte inZone) const { return (inZone ? mNoteChannels[inNote] >> 4 : mNoteChannels[inNote]) & 0x0F; }
+
+	void set_index(byte inNote, byte inZone, byte inIndex) {
+		if (inZone) mNoteChannels[inNote] = (mNoteChannels[inNote] & 0x0F) | (inIndex << 4);
+		else mNoteChannels[inNote] = (mNoteChannels[inNote] & 0xF0) | inIndex;
+	}
+
+	void init_allocator(byte inZone) {
+		Allocator & allocator = mAllocators[inZone];
+		const byte members = mZones.getMembers(inZone);
+		for (byte i=0;i<members;i++) allocator.free[i] = i;
+		allocator.head = 0;
+		allocator.count = members;
+		allocator.next = 0;
+	}
+
+	byte allocate(byte inZone) {
+		Allocator & allocator = mAllocators[inZone];
+		if (allocator.count != 0) {
+			const byte index = allocator.free[allocator.head];
+			allocator.head = (allocator.head == 14) ? 0 : allocator.head + 1;
+			allocator.count--;
+			return index;
+		}
+		const byte index = allocator.next;
+		allocator.next = (index + 1 >= mZones.getMembers(inZone)) ? 0 : index + 1;
+		return index;
+	}
+
+	void free_channel(byte inZone, byte inIndex) {
+		Allocator & allocator = mAllocators[inZone];
+		byte tail = allocator.head + allocator.count;
+		if (tail >= 15) tail -= 15;
+		allocator.free[tail] = inIndex;
+		allocator.count++;
+	}
+
+	// Note Off for the notes of a zone, laid out with inMembers member channels.
+	void release_zone(byte inZone, byte inMembers) {
+		for (byte note=0;note<128;note++) {
+			const byte index = get_index(note,inZone);
+			if (index == 0) continue;
+			set_index(note,inZone,0);
+			if (index <= inMembers) {
+				const byte channel = MIDI_MPEZones::getMemberChannel(inZone,index - 1);
+				mActive[channel - 1] = 0;
+				mInterface.sendNoteOff(note,0,channel);
+			}
+		}
+	}
+
+	void send_rpn(byte inNumber, byte inValue, byte inChannel) {
+		mInterface.sendControlChange(101,0,inChannel);
+		mInterface.sendControlChange(100,inNumber,inChannel);
+		mInterface.sendControlChange(6,inValue,inChannel);
+		mInterface.sendControlChange(101,127,inChannel);		// RPN Null
+		mInterface.sendControlChange(100,127,inChannel);
+	}
+
+	void send_bend(unsigned int inBend, byte inChannel) {
+		if (inBend > 16383) inBend = 16383;
+		if (mBend[inChannel - 1] == inBend) return;
+		mBend[inChannel - 1] = inBend;
+		mInterface.sendPitchBend(inBend,inChannel);
+	}
+
+	void send_pressure(byte inPressure, byte inChannel) {
+		inPressure &= 0x7F;
+		if (mPressure[inChannel - 1] == inPressure) return;
+		mPressure[inChannel - 1] = inPressure;
+		mInterface.sendAfterTouch(inPressure,inChannel);
+	}
+
+	void send_timbre(byte inTimbre, byte inChannel) {
+		inTimbre &= 0x7F;
+		if (mTimbre[inChannel - 1] == inTimbre) return;
+		mTimbre[inChannel - 1] = inTimbre;
+		mInterface.sendControlChange(74,inTimbre,inChannel);
+	}
+
+	byte			mNoteChannels[128];		// Member index + 1 of each note, 0 if off: low nibble lower zone, high nibble upper zone
+	byte			mActive[16];			// Notes on each channel
+	uint16_t		mBend[16];				// Last values sent on each channel
+	byte			mPressure[16];
+	byte			mTimbre[16];
+	Allocator		mAllocators[2];
+	MIDI_MPEZones	mZones;
+	Interface &		mInterface;
+
+};
+
+
+/*! \brief Expression of a note received: the state of its member channel. */
+struct MIDI_MPENote {
+	byte		note;		///< Last note received on the channel
+	byte		velocity;	///< Note On velocity
+	bool		on;			///< The note is held
+	uint16_t	bend;		///< Pitch bend of the channel (0 to 16383, center 8192)
+	byte		pressure;	///< Channel AfterTouch
+	byte		timbre;		///< CC 74
+};
+
+
+/*! \brief MPE input: the expression of each note, from the messages of its member channel and of the zone manager.
+
+ Attach it to an interface with setMPEReader(), or feed it with process().
+ The zones follow the MPE Configuration Messages received (the lower zone
+ with 15 members until then), and the pitch bend ranges the RPN 0.
+ \code
+ MIDI_MPEReader mpe;
+
+ void handleNote(byte inChannel, const MIDI_MPENote & inNote) {
+ 	if (inNote.on) voice(inChannel).set(mpe.getPitch(inChannel),inNote.pressure,inNote.timbre);
+ 	else voice(inChannel).release();
+ }
+
+ void setup() {
+ 	mpe.setHandleNote(handleNote);
+ 	MIDI.setMPEReader(&mpe);
+ 	MIDI.begin(MIDI_CHANNEL_OMNI);
+ }
+ \endcode
+ A member channel holds one note: a new Note On on a busy channel replaces it.
+ */
+class MIDI_MPEReader {
+
+public:
+
+	MIDI_MPEReader() : mNoteCallback(NULL) {
+		mZones.set(MPELowerZone,15);
+		reset();
+	}
+
+	/*! \brief Forget the notes, the expression and the pitch bend ranges (the zones are kept). */
+	void reset() {
+		for (byte c=0;c<16;c++) {
+			MIDI_MPENote & state = mChannels[c];
+			state.note = 0;
+			state.velocity = 0;
+			state.on = false;
+			state.bend = 8192;
+			state.pressure = 0;
+			state.timbre = 64;
+			mParameters[c][0] = NoParameter;
+			mParameters[c][1] = NoParameter;
+		}
+		for (byte z=0;z<2;z++) reset_ranges(z);
+	}
+
+	/*! \brief Set the number of member channels of a zone (kMPEZone), as an MPE Configuration Message would. */
+	void configure(byte inZone, byte inMembers) {
+		mZones.set(inZone,inMembers);
+		reset_ranges(inZone & 0x01);
+	}
+
+	/*! \brief The zones configured. */
+	const MIDI_MPEZones & getZones() const { return mZones; }
+
+	/*! \brief Called on Note On and Note Off, and when the expression of a held note changes (its channel, or its zone manager). */
+	void setHandleNote(void (*fptr)(byte inChannel, const MIDI_MPENote & inNote)) { mNoteCallback = fptr; }
+
+	/*! \brief Hook for MIDI_Interface: a message was received. */
+	void received(kMIDIType inType, byte inData1, byte inData2, byte inChannel) { process(inType,inData1,inData2,inChannel); }
+
+	/*! \brief Update the notes with a message (any type, only the MPE related messages are used). */
+	void process(kMIDIType inType, byte inData1, byte inData2, byte inChannel) {
+
+		if (inChannel < 1 || inChannel > 16) return;
+
+		MIDI_MPENote & state = mChannels[inChannel - 1];
+		switch (inType) {
+
+			case NoteOn:
+				if (inData2 != 0) {
+					if (mZones.getZone(inChannel) == MPENoZone) return;
+					state.note = inData1;
+					state.velocity = inData2;
+					state.on = true;
+					notify(inChannel);
+					return;
+				}
+				// Null velocity: Note Off.
+				// fall through
+			case NoteOff:
+				if (!state.on || state.note != inData1) return;
+				state.on = false;
+				notify(inChannel);
+				return;
+
+			case PitchBend:
+				state.bend = ((uint16_t)inData2 << 7) | inData1;
+				changed(inChannel);
+				return;
+
+			case AfterTouchChannel:
+				state.pressure = inData1;
+				changed(inChannel);
+				return;
+
+			case ControlChange:
+				control_change(inData1,inData2,inChannel);
+				return;
+
+			default:
+				return;
+		}
+	}
+
+	/*! \brief State of a channel (1 to 16). */
+	const MIDI_MPENote & getNote(byte inChannel) const { return mChannels[(inChannel - 1) & 0x0F]; }
+
+	/*! \brief Channel of a note held in a zone (kMPEZone), 0 if not found. */
+	byte find(byte inNote, byte inZone) const {
+		const byte members = mZones.getMembers(inZone);
+		for (byte i=0;i<members;i++) {
+			const byte channel = MIDI_MPEZones::getMemberChannel(inZone,i);
+			const MIDI_MPENote & state = mChannels[channel - 1];
+			if (state.on && state.note == inNote) return channel;
+		}
+		return 0;
+	}
+
+	/*! \brief Pitch of the note of a channel (1 to 16), in 1/256 semitone: the note, its pitch bend and the pitch bend of its zone manager. */
+	long getPitch(byte inChannel) const {
+		const MIDI_MPENote & state = getNote(inChannel);
+		long pitch = (long)state.note << 8;
+		const byte zone = mZones.getZone(inChannel);
+		if (zone == MPENoZone) return pitch;
+
+		// (bend - 8192) / 8192 * range * 256
+		const byte manager = MIDI_MPEZones::getManagerChannel(zone);
+		if (inChannel != manager) pitch += ((long)state.bend - 8192) * mBendRanges[zone][0] / 32;
+		pitch += ((long)mChannels[manager - 1].bend - 8192) * mBendRanges[zone][1] / 32;
+		return pitch;
+	}
+
+	/*! \brief Pitch bend range of the member channels of a zone, in semitones. */
+	byte getBendRange(byte inZone) const { return mBendRanges[inZone & 0x01][0]; }
+
+	/*! \brief Pitch bend range of the manager channel of a zone, in semitones. */
+	byte getManagerBendRange(byte inZone) const { return mBendRanges[inZone & 0x01][1]; }
+
+private:
+
+	enum {
+		NoParameter = 0xFF
+	};
+
+	void reset_ranges(byte inZone) {
+		mBendRanges[inZone][0] = 48;
+		mBendRanges[inZone][1] = 2;
+	}
+
+	void control_change(byte inNumber, byte inValue, byte inChannel) {
+
+		const byte parameter = (mParameters[inChannel - 1][0] == 0) ? mParameters[inChannel - 1][1] : (byte)NoParameter;
+		switch (inNumber) {
+
+			case 74:
+				mChannels[inChannel - 1].timbre = inValue;
+				changed(inChannel);
+				return;
+
+			case 101:	// RPN MSB
+				mParameters[inChannel - 1][0] = inValue;
+				return;
+
+			case 100:	// RPN LSB
+				mParameters[inChannel - 1][1] = inValue;
+				return;
+
+			case 99:	// NRPN: no RPN selected
+			case 98:
+				mParameters[inChannel - 1][0] = NoParameter;
+				return;
+
+			case 6:		// Data Entry MSB
+				if (parameter == 6 && (inChannel == 1 || inChannel == 16)) {
+					reconfigure((inChannel == 1) ? MPELowerZone : MPEUpperZone,inValue);
+				}
+				else if (parameter == 0) {
+					const byte zone = mZones.getZone(inChannel);
+					if (zone == MPENoZone) return;
+					mBendRanges[zone][mZones.isManager(inChannel) ? 1 : 0] = inValue;
+				}
+				return;
+
+			case 120:	// All Sound Off
+			case 123:	// All Notes Off
+				if (mChannels[inChannel - 1].on) {
+					mChannels[inChannel - 1].on = false;
+					notify(inChannel);
+				}
+				if (mZones.isManager(inChannel)) {
+					const byte zone = mZones.getZone(inChannel);
+					const byte members = mZones.getMembers(zone);
+					for (byte i=0;i<members;i++) {
+						const byte channel = MIDI_MPEZones::getMemberChannel(zone,i);
+						if (!mChannels[channel - 1].on) continue;
+						mChannels[channel - 1].on = false;
+						notify(channel);
+					}
+				}
+				return;
+
+			default:
+				return;
+		}
+	}
+
+	// Expression of a channel changed: its note, or all the notes of the zone for the manager.
+	void changed(byte inChannel) {
+		if (!mZones.isManager(inChannel)) {
+			if (mChannels[inChannel - 1].on && mZones.getZone(inChannel) != MPENoZone) notify(inChannel);
+			return;
+		}
+		const byte zone = mZones.getZone(inChannel);
+		const byte members = mZones.getMembers(zone);
+		if (mChannels[inChannel - 1].on) notify(inChannel);
+		for (byte i=0;i<members;i++) {
+			const byte channel = MIDI_MPEZones::getMemberChannel(zone,i);
+			if (mChannels[channel - 1].on) notify(channel);
+		}
+	}
+
+	// MPE Configuration Message: the notes of the zone, and of the channels moved to another zone, end.
+	void reconfigure(byte inZone, byte inMembers) {
+		byte before[16];
+		for (byte c=0;c<16;c++) before[c] = mZones.getZone(c + 1);
+		configure(inZone,inMembers);
+		for (byte c=1;c<=16;c++) {
+			if (!mChannels[c - 1].on || (before[c - 1] != inZone && before[c - 1] == mZones.getZone(c))) continue;
+			mChannels[c - 1].on = false;
+			notify(c);
+		}
+	}
+
+	void notify(byte inChannel) {
+		if (mNoteCallback != NULL) mNoteCallback(inChannel,mChannels[inChannel - 1]);
+	}
+
+	MIDI_MPENote	mChannels[16];
+	byte			mParameters[16][2];		// RPN selected on each channel: MSB, LSB (NoParameter for a NRPN)
+	byte			mBendRanges[2][2];		// [zone][member, manager], semitones
+	MIDI_MPEZones	mZones;
+
+	void (*mNoteCallback)(byte inChannel, const MIDI_MPENote & inNote);
+
+};
+
+
+#endif // LIB_MIDI_MPE_H_
@@ -0,0 +1,191 @@
+/*!
+ *  @file		MIDI_Merge.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Merge of several MIDI inputs into one output
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_MERGE_H_
+#define LIB_MIDI_MERGE_H_
+
+#include "MIDI_Defs.h"
+
+
+/*
+    ###############################################################
+    #                                                             #
+    #    MERGE                                                    #
+    #                                                             #
+    #    Maximum number of inputs of a MIDI_Merger, and number    #
+    #    of SysEx bytes written to the output per update() call.  #
+    #    Define them before including the library to change them. #
+    #                                                             #
+    ###############################################################
+ */
+
+#ifndef MIDI_MERGE_INPUTS
+#define MIDI_MERGE_INPUTS		4
+#endif
+
+#ifndef MIDI_MERGE_SYSEX_CHUNK
+#define MIDI_MERGE_SYSEX_CHUNK	16
+#endif
+
+
+/*! \brief Merge the messages received by several MIDI_Interface objects into one output.
+
+ Messages are written whole, so they never mix on the output, and the output
+ keeps its running status whatever input they come from. Inputs are polled in
+ turn (one message per input and per update() call), so a busy input can't
+ starve the others.
+
+ SysEx are received whole by the inputs, so a long dump arriving slowly on one
+ input does not hold the output. Once complete, it is written by chunks of
+ MIDI_MERGE_SYSEX_CHUNK bytes: in between, Real Time messages of the other
+ inputs are written immediately (they are allowed inside a SysEx), the other
+ messages wait in their input until the end of the SysEx.
+ \code
+ MIDI_Merger merger;
+ merger.setOutput(MIDI);
+ merger.addInput(MIDI);
+ merger.addInput(usbMIDI);
+ ...
+ void loop() { merger.update(); }
+ \endcode
+ The inputs are read on all channels, and their Thru is turned off.
+ */
+class MIDI_Merger {
+
+public:
+
+	MIDI_Merger() : mOutput(NULL), mForward(NULL), mNumInputs(0), mNextInput(0), mSysExOwner(NoOwner) { }
+
+	/*! \brief Set the interface the merged messages are sent to. */
+	template<class Interface>
+	void setOutput(Interface & inInterface) {
+		mOutput = &inInterface;
+		mForward = &MIDI_Merger::forward_to<Interface>;
+	}
+
+	/*! \brief Add an input, returns false if there are already MIDI_MERGE_INPUTS inputs. */
+	template<class Interface>
+	bool addInput(Interface & inInterface) {
+		if (mNumInputs >= MIDI_MERGE_INPUTS) return false;
+		inInterface.turnThruOff();
+		mInputs[mNumInputs].object = &inInterface;
+		mInputs[mNumInputs].read = &MIDI_Merger::read_from<Interface>;
+		mInputs[mNumInputs].pending = false;
+		mNumInputs++;
+		return true;
+	}
+
+	/*! \brief Read the inputs and write their messages to the output. Call it as often as possible (in loop()). */
+	void update() {
+
+		if (mOutput == NULL) return;
+
+		for (byte n=0;n<mNumInputs;n++) {
+
+			const byte i = mNextInput;
+			if (++mNextInput >= mNumInputs) mNextInput = 0;
+
+			// The SysEx owner is not read until its SysEx is written: its buffer holds the data.
+			if (i == mSysExOwner) continue;
+
+			Input & input = mInputs[i];
+			if (input.pending) continue;
+
+			if (!input.read(input.object,input.message)) continue;
+
+			if (input.message.type >= Clock || mSysExOwner == NoOwner) write(i);
+			else input.pending = true;		// Wait for the end of the SysEx being written.
+		}
+
+		if (mSysExOwner != NoOwner) write_sysex_chunk();
+	}
+
+private:
+
+	enum { NoOwner = 0xFF };
+
+	struct Message {
+		kMIDIType	type;
+		byte		data1;
+		byte		data2;
+		byte		channel;
+		byte *		sysex;
+	};
+
+	struct Input {
+		void *		object;
+		bool		(*read)(void * inObject, Message & outMessage);
+		Message		message;
+		bool		pending;
+	};
+
+	template<class Interface>
+	static bool read_from(void * inObject, Message & outMessage) {
+		Interface & input = *static_cast<Interface*>(inObject);
+		if (!input.read(MIDI_CHANNEL_OMNI)) return false;
+		outMessage.type = input.getType();
+		outMessage.data1 = input.getData1();
+		outMessage.data2 = input.getData2();
+		outMessage.channel = input.getChannel();
+		outMessage.sysex = input.getSysExArray();
+		return true;
+	}
+
+	template<class Interface>
+	static void forward_to(void * inObject, kMIDIType inType, byte inData1, byte inData2, byte inChannel, byte * inSysEx) {
+		static_cast<Interface*>(inObject)->forward(inType,inData1,inData2,inChannel,inSysEx);
+	}
+
+	// Write the message of an input, SysEx are started and written by chunks.
+	void write(byte inInput) {
+		const Message & m = mInputs[inInput].message;
+		if (m.type == SystemExclusive) {
+			mSysExOwner = inInput;
+			mSysExSent = 0;
+		}
+		else mForward(mOutput,m.type,m.data1,m.data2,m.channel,m.sysex);
+	}
+
+	void write_sysex_chunk() {
+
+		const Message & m = mInputs[mSysExOwner].message;
+		byte length = m.data1 - mSysExSent;
+		if (length > MIDI_MERGE_SYSEX_CHUNK) length = MIDI_MERGE_SYSEX_CHUNK;
+
+		// The chunk is sent as raw bytes (the array contains the boundaries), the SysEx is counted with its first chunk.
+		mForward(mOutput,SystemExclusive,length,0,0,m.sysex + mSysExSent);
+		mSysExSent += length;
+		if (mSysExSent < m.data1) return;
+
+		// SysEx done: release the output, and write the messages that were waiting (maybe another SysEx).
+		mSysExOwner = NoOwner;
+		for (byte n=0;n<mNumInputs;n++) {
+			const byte i = (mNextInput + n) % mNumInputs;
+			if (!mInputs[i].pending) continue;
+			if (mSysExOwner != NoOwner && mInputs[i].message.type == SystemExclusive) continue;
+			mInputs[i].pending = false;
+			write(i);
+		}
+	}
+
+	void *		mOutput;
+	void		(*mForward)(void * inObject, kMIDIType inType, byte inData1, byte inData2, byte inChannel, byte * inSysEx);
+
+	Input		mInputs[MIDI_MERGE_INPUTS];
+	byte		mNumInputs;
+	byte		mNextInput;
+
+	byte		mSysExOwner;	// Input whose SysEx is being written, NoOwner if none.
+	byte		mSysExSent;
+
+};
+
+
+#endif // LIB_MIDI_MERGE_H_
@@ -0,0 +1,167 @@
+/*!
+ *  @file		MIDI_Notes.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Tracking of the notes being held
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_NOTES_H_
+#define LIB_MIDI_NOTES_H_
+
+#include "MIDI_Defs.h"
+
+
+/*! \brief State of the 128 notes of the 16 channels, a bit per note (256 bytes).
+
+ Attach it to an interface with setNoteTracker(), on the input (notes
+ received), the output (notes sent), or both. Or feed it yourself with
+ process(). Note Off, Note On with a null velocity, All Notes Off and All
+ Sound Off release the notes, System Reset releases them all.
+ \code
+ MIDI_NoteTracker sent;
+
+ void setup() {
+ 	MIDI.begin();
+ 	MIDI.setNoteTracker(NULL,&sent);
+ }
+
+ void panic() { sent.releaseAll(MIDI); }		// Note Off for the held notes only.
+ \endcode
+ The bytes forwarded by the cut-through Thru (MIDI_DefaultSettings::ThruCutThrough)
+ don't go through the output tracker.
+ */
+class MIDI_NoteTracker {
+
+public:
+
+	MIDI_NoteTracker() { reset(); }
+
+	/*! \brief Forget all the notes. */
+	void reset() {
+		for (byte c=0;c<16;c++) clear_channel(c);
+	}
+
+	/*! \brief Update the notes with a message (any type, only the notes and the related messages are used). */
+	void process(kMIDIType inType, byte inData1, byte inData2, byte inChannel) {
+
+		if (inType == SystemReset) {
+			reset();
+			return;
+		}
+		if (inChannel < 1 || inChannel > 16) return;
+
+		const byte c = inChannel - 1;
+		switch (inType) {
+			case NoteOn:
+				if (inData2 != 0) {
+					mNotes[c][(inData1 >> 3) & 0x0F] |= (1 << (inData1 & 0x07));
+					break;
+				}
+				// Null velocity: Note Off.
+				// fall through
+			case NoteOff:
+				mNotes[c][(inData1 >> 3) & 0x0F] &= ~(1 << (inData1 & 0x07));
+				break;
+			case ControlChange:
+				if (inData1 == 120 || inData1 == 123) clear_channel(c);	// All Sound Off, All Notes Off
+				break;
+			default:
+				break;
+		}
+	}
+
+	/*! \brief Check if a note is held on a channel (1 to 16). */
+	bool isOn(byte inChannel, byte inNote) const {
+		return (mNotes[(inChannel - 1) & 0x0F][(inNote >> 3) & 0x0F] >> (inNote & 0x07)) & 0x01;
+	}
+
+	/*! \brief Number of notes held on a channel (1 to 16). */
+	byte count(byte inChannel) const {
+		const byte * notes = mNotes[(inChannel - 1) & 0x0F];
+		byte total = 0;
+		for (byte i=0;i<16;i++) {
+			for (byte bits=notes[i];bits;bits&=bits-1) total++;
+		}
+		return total;
+	}
+
+	/*! \brief Number of notes held on all the channels. */
+	unsigned int count() const {
+		unsigned int total = 0;
+		for (byte c=1;c<=16;c++) total += count(c);
+		return total;
+	}
+
+	/*! \brief Lowest note held on a channel (1 to 16), 0xFF if none. */
+	byte lowest(byte inChannel) const {
+		const byte * notes = mNotes[(inChannel - 1) & 0x0F];
+		for (byte i=0;i<16;i++) {
+			if (notes[i] == 0) continue;
+			byte bit = 0;
+			while (!(notes[i] & (1 << bit))) bit++;
+			return (i << 3) | bit;
+		}
+		return 0xFF;
+	}
+
+	/*! \brief Highest note held on a channel (1 to 16), 0xFF if none. */
+	byte highest(byte inChannel) const {
+		const byte * notes = mNotes[(inChannel - 1) & 0x0F];
+		for (byte i=16;i-->0;) {
+			if (notes[i] == 0) continue;
+			byte bit = 7;
+			while (!(notes[i] & (1 << bit))) bit--;
+			return (i << 3) | bit;
+		}
+		return 0xFF;
+	}
+
+	/*! \brief Channels with notes held, a bit per channel (bit 0 for channel 1). */
+	uint16_t getChannels() const {
+		uint16_t channels = 0;
+		for (byte c=0;c<16;c++) {
+			for (byte i=0;i<16;i++) {
+				if (mNotes[c][i]) {
+					channels |= 1U << c;
+					break;
+				}
+			}
+		}
+		return channels;
+	}
+
+	/*! \brief Send a Note Off for each note held on a channel (1 to 16), and forget them. */
+	template<class Interface>
+	void releaseChannel(Interface & inInterface, byte inChannel) {
+		byte * notes = mNotes[(inChannel - 1) & 0x0F];
+		for (byte i=0;i<16;i++) {
+			const byte bits = notes[i];		// The tracker may be updated by the interface.
+			notes[i] = 0;
+			if (bits == 0) continue;
+			for (byte bit=0;bit<8;bit++) {
+				if (bits & (1 << bit)) inInterface.sendNoteOff((i << 3) | bit,0,inChannel);
+			}
+		}
+	}
+
+	/*! \brief Send a Note Off for each note held, and forget them. Only the notes held are sent, not 2048 Note Off. */
+	template<class Interface>
+	void releaseAll(Interface & inInterface) {
+		for (byte c=1;c<=16;c++) releaseChannel(inInterface,c);
+	}
+
+private:
+
+	void clear_channel(byte inIndex) {
+		for (byte i=0;i<16;i++) mNotes[inIndex][i] = 0;
+	}
+
+	byte	mNotes[16][16];		// [channel][note / 8], bit (note % 8)
+
+};
+
+
+#endif // LIB_MIDI_NOTES_H_
@@ -0,0 +1,141 @@
+/*!
+ *  @file		MIDI_Profile.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Cycle count profiling of the read path
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_PROFILE_H_
+#define LIB_MIDI_PROFILE_H_
+
+#include "MIDI_Defs.h"
+
+
+/*
+    ###############################################################
+    #                                                             #
+    #    PROFILING                                                #
+    #                                                             #
+    #    Set MIDI_PROFILING to 1 to measure the time spent in     #
+    #    parse(), input_filter(), thru_filter() and               #
+    #    launchCallback() by read(). The statistics can be read   #
+    #    at runtime with getProfile().                            #
+    #    When set to 0, the probes are removed by the             #
+    #    preprocessor and cost nothing.                           #
+    #                                                             #
+    ###############################################################
+ */
+
+#ifndef MIDI_PROFILING
+#define MIDI_PROFILING			0
+#endif
+
+
+/*! Probes of the read path. */
+enum kMIDIProbe {
+	ProbeParse            = 0,	///< Extraction of the bytes from the serial port and parsing (only when data is available)
+	ProbeInputFilter      = 1,	///< Channel filtering of the received message
+	ProbeThruFilter       = 2,	///< Soft Thru filtering and sending
+	ProbeCallback         = 3,	///< Callback dispatching (including the time spent in your callback)
+	NumProbes             = 4
+};
+
+
+/*! Statistics of a probe, in timer ticks (CPU cycles with the default AVR timer). */
+struct MIDI_ProfileStats {
+	uint16_t	min;		///< Shortest measure
+	uint16_t	max;		///< Longest measure
+	uint32_t	total;		///< Sum of the measures
+	uint16_t	count;		///< Number of measures
+
+	/*! \brief Average of the measures. */
+	uint16_t average() const { return count ? (uint16_t)(total / count) : 0; }
+};
+
+
+#if MIDI_PROFILING
+
+/*
+ The timer is read with MIDI_PROFILE_TIMER(), which must return a free running
+ 16 bit counter. Measures longer than one timer period (65536 ticks) wrap around.
+ By default on AVR, Timer1 is used without prescaler (one tick per CPU cycle),
+ see MIDI_Profiler::beginTimer(). Define MIDI_PROFILE_TIMER before including
+ the library to use another timer.
+ */
+#ifndef MIDI_PROFILE_TIMER
+#if defined(__AVR__)
+#include <avr/io.h>
+#define MIDI_PROFILE_TIMER()	((uint16_t)TCNT1)
+#define MIDI_PROFILE_USE_TIMER1	1
+#else
+#error "MIDI_PROFILING needs a timer, please define MIDI_PROFILE_TIMER()."
+#endif
+#endif
+
+
+/*! \brief Min/max/average accumulator for the probes of the read path. */
+class MIDI_Profiler {
+
+public:
+
+	MIDI_Profiler() { reset(); }
+
+	/*! \brief Setup Timer1 as a free running cycle counter.
+
+	 Call this in setup() when using the default AVR timer.
+	 Warning: this reconfigures Timer1, so analogWrite on its pins and the
+	 libraries using it (eg: Servo) won't work anymore.
+	 */
+	static void beginTimer() {
+#if MIDI_PROFILE_USE_TIMER1
+		TCCR1A = 0;				// Normal mode
+		TCCR1B = (1 << CS10);	// No prescaler
+#endif
+	}
+
+	void reset() {
+		for (byte i=0;i<NumProbes;i++) {
+			mStats[i].min = 0xFFFF;
+			mStats[i].max = 0;
+			mStats[i].total = 0;
+			mStats[i].count = 0;
+		}
+	}
+
+	void record(kMIDIProbe inProbe, uint16_t inTicks) {
+		MIDI_ProfileStats & stats = mStats[inProbe];
+		if (inTicks < stats.min) stats.min = inTicks;
+		if (inTicks > stats.max) stats.max = inTicks;
+		if (stats.count == 0xFFFF) {
+			// Halve the accumulator to keep the average without overflowing.
+			stats.total >>= 1;
+			stats.count >>= 1;
+		}
+		stats.total += inTicks;
+		stats.count++;
+	}
+
+	const MIDI_ProfileStats & get(kMIDIProbe inProbe) const { return mStats[inProbe]; }
+
+private:
+
+	MIDI_ProfileStats	mStats[NumProbes];
+
+};
+
+
+#define MIDI_PROFILE_BEGIN(probe)	const uint16_t midi_profile_start_##probe = MIDI_PROFILE_TIMER()
+#define MIDI_PROFILE_END(probe)		this->mProfiler.record(probe,(uint16_t)(MIDI_PROFILE_TIMER() - midi_profile_start_##probe))
+
+#else
+
+#define MIDI_PROFILE_BEGIN(probe)
+#define MIDI_PROFILE_END(probe)
+
+#endif // MIDI_PROFILING
+
+
+#endif // LIB_MIDI_PROFILE_H_
@@ -0,0 +1,174 @@
+/*!
+ *  @file		MIDI_Routing.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Message routing between several MIDI ports
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_ROUTING_H_
+#define LIB_MIDI_ROUTING_H_
+
+#include "MIDI_Defs.h"
+
+
+/*
+    ###############################################################
+    #                                                             #
+    #    ROUTING                                                  #
+    #                                                             #
+    #    Maximum number of ports and routes of a MIDI_Router.     #
+    #    Each route uses 9 bytes of RAM, each port 4 bytes       #
+    #    (on AVR). Define them before including the library to    #
+    #    change them. Ports are limited to 8 (bit masks).         #
+    #                                                             #
+    ###############################################################
+ */
+
+#ifndef MIDI_ROUTER_PORTS
+#define MIDI_ROUTER_PORTS		4
+#endif
+
+#ifndef MIDI_ROUTER_ROUTES
+#define MIDI_ROUTER_ROUTES		8
+#endif
+
+
+/*! Bit masks for MIDI_Route. */
+#define MIDI_PORT_BIT(port)			((byte)(1 << (port)))
+#define MIDI_CHANNEL_BIT(channel)	((uint16_t)(1U << ((channel)-1)))
+#define MIDI_TYPE_BIT(type)			((uint32_t)1 << getTypeSlot(type))
+
+#define MIDI_ALL_PORTS				0xFF
+#define MIDI_ALL_CHANNELS			0xFFFF
+#define MIDI_ALL_TYPES				0x007FFFFFUL
+#define MIDI_CHANNEL_TYPES			0x0000007FUL		///< NoteOff to PitchBend
+#define MIDI_SYSTEM_TYPES			0x007FFF80UL		///< SysEx, System Common and Real Time
+#define MIDI_REALTIME_TYPES			0x007F8000UL		///< Clock to SystemReset
+
+
+/*! \brief A route: received messages matching the input ports, channels and types are sent to the output ports.
+
+ System messages have no channel, they match any route whose types include them.
+ Example, notes of channels 1 to 4 from port 0 to ports 1 and 2, on channel 10:
+ \code
+ MIDI_Route route = { MIDI_PORT_BIT(0), 0x000F, MIDI_TYPE_BIT(NoteOn) | MIDI_TYPE_BIT(NoteOff), MIDI_PORT_BIT(1) | MIDI_PORT_BIT(2), 10 };
+ \endcode
+ */
+struct MIDI_Route {
+	byte		inputs;		///< Input ports (MIDI_PORT_BIT)
+	uint16_t	channels;	///< Input channels (MIDI_CHANNEL_BIT)
+	uint32_t	types;		///< Message types (MIDI_TYPE_BIT)
+	byte		outputs;	///< Output ports (MIDI_PORT_BIT)
+	byte		outChannel;	///< Output channel of channel messages (1 to 16), MIDI_CHANNEL_OMNI keeps the input channel.
+
+	/*! \brief Check if a message received on a given port matches the route. */
+	bool matches(byte inPortBit, kMIDIType inType, byte inChannel) const {
+		if (!(inputs & inPortBit) || !(types & MIDI_TYPE_BIT(inType))) return false;
+		return (inType >= SystemExclusive) || (channels & MIDI_CHANNEL_BIT(inChannel));
+	}
+};
+
+
+/*! \brief Routing matrix between several MIDI_Interface objects (eg: UART and USB on Teensy, or several UARTs).
+
+ Each interface is given a port number with setPort(). Messages received by
+ read() on a port are then forwarded according to the routes, instead of the
+ local Thru filter of the interface (turnThruOff() still stops the forwarding
+ of its input).
+ \code
+ MIDI_Router router;
+ router.setPort(0,MIDI);
+ router.setPort(1,usbMIDI);
+ router.addRoute(MIDI_PORT_BIT(0),MIDI_ALL_CHANNELS,MIDI_ALL_TYPES,MIDI_PORT_BIT(1));					// DIN -> USB
+ router.addRoute(MIDI_PORT_BIT(1),MIDI_CHANNEL_BIT(1),MIDI_CHANNEL_TYPES,MIDI_PORT_BIT(0),2);			// USB channel 1 -> DIN channel 2
+ \endcode
+ */
+class MIDI_Router {
+
+public:
+
+	MIDI_Router() : mNumRoutes(0) {
+		for (byte i=0;i<MIDI_ROUTER_PORTS;i++) {
+			mPorts[i].object = NULL;
+			mPorts[i].forward = NULL;
+		}
+	}
+
+	/*! \brief Attach an interface to a port of the router (0 to MIDI_ROUTER_PORTS-1). */
+	template<class Interface>
+	void setPort(byte inPort, Interface & inInterface) {
+		if (inPort >= MIDI_ROUTER_PORTS) return;
+		mPorts[inPort].object = &inInterface;
+		mPorts[inPort].forward = &MIDI_Router::forward_to<Interface>;
+		inInterface.setRouter(this,inPort);
+	}
+
+	/*! \brief Add a route, returns false if the table is full. */
+	bool addRoute(const MIDI_Route & inRoute) {
+		if (mNumRoutes >= MIDI_ROUTER_ROUTES) return false;
+		mRoutes[mNumRoutes++] = inRoute;
+		return true;
+	}
+
+	/*! \brief Add a route, returns false if the table is full. See MIDI_Route for the parameters. */
+	bool addRoute(byte inInputs, uint16_t inChannels, uint32_t inTypes, byte inOutputs, byte inOutChannel = MIDI_CHANNEL_OMNI) {
+		MIDI_Route route = { inInputs, inChannels, inTypes, inOutputs, inOutChannel };
+		return addRoute(route);
+	}
+
+	void clearRoutes() { mNumRoutes = 0; }
+
+	/*! \brief Forward a message received on inPort to the outputs of the matching routes.
+
+	 Called by MIDI_Interface::read(). A message is sent only once to each
+	 output port, unless its channel is changed by another route.
+	 */
+	void route(byte inPort, kMIDIType inType, byte inData1, byte inData2, byte inChannel, byte * inSysEx) {
+
+		const byte port_bit = MIDI_PORT_BIT(inPort);
+		byte sent = 0;	// Outputs which already have the message as received.
+
+		for (byte r=0;r<mNumRoutes;r++) {
+
+			const MIDI_Route & current = mRoutes[r];
+			if (!current.matches(port_bit,inType,inChannel)) continue;
+
+			byte outputs = current.outputs;
+			byte channel = inChannel;
+			if (current.outChannel != MIDI_CHANNEL_OMNI && inType < SystemExclusive) channel = current.outChannel;
+			else {
+				outputs &= ~sent;
+				sent |= outputs;
+			}
+
+			for (byte p=0;outputs && p<MIDI_ROUTER_PORTS;p++,outputs>>=1) {
+				if ((outputs & 1) && mPorts[p].object != NULL) {
+					mPorts[p].forward(mPorts[p].object,inType,inData1,inData2,channel,inSysEx);
+				}
+			}
+		}
+	}
+
+private:
+
+	template<class Interface>
+	static void forward_to(void * inObject, kMIDIType inType, byte inData1, byte inData2, byte inChannel, byte * inSysEx) {
+		static_cast<Interface*>(inObject)->forward(inType,inData1,inData2,inChannel,inSysEx);
+	}
+
+	struct Port {
+		void *	object;
+		void	(*forward)(void * inObject, kMIDIType inType, byte inData1, byte inData2, byte inChannel, byte * inSysEx);
+	};
+
+	Port		mPorts[MIDI_ROUTER_PORTS];
+	MIDI_Route	mRoutes[MIDI_ROUTER_ROUTES];
+	byte		mNumRoutes;
+
+};
+
+
+#endif // LIB_MIDI_ROUTING_H_
@@ -0,0 +1,159 @@
+/*!
+ *  @file		MIDI_Scheduler.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Timestamped output queue
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_SCHEDULER_H_
+#define LIB_MIDI_SCHEDULER_H_
+
+#include "MIDI_Defs.h"
+#include "MIDI_Time.h"
+
+
+/*! \brief Queue of messages to send at a given time.
+
+ Messages are stored sorted by time (messages with the same time keep their
+ order), and sent by dispatch() when their time has come. Times are in
+ microseconds (MIDI_MICROS()) by default, but any unit works as long as
+ schedule() and dispatch() use the same: eg: clock ticks from a sequencer.
+
+ For output timing independent from loop(), call dispatch() from a timer
+ interrupt. Example with Timer2 on Arduino (ATmega168/328), 4 kHz:
+ \code
+ MIDI_Scheduler<MIDI_Class> scheduler(MIDI);
+
+ ISR(TIMER2_COMPA_vect) { scheduler.dispatch(); }
+
+ void setup() {
+ 	MIDI.begin();
+ 	TCCR2A = (1 << WGM21);					// CTC mode
+ 	TCCR2B = (1 << CS22);					// 16 MHz / 64
+ 	OCR2A = 61;								// / 62 = 4 kHz (250 us)
+ 	TIMSK2 = (1 << OCIE2A);
+ }
+
+ void loop() {
+ 	scheduler.scheduleNote(micros() + 1000,60,100,1,250000);	// In 1 ms, for 250 ms.
+ 	...
+ }
+ \endcode
+ When dispatch() runs in an interrupt, don't use the send methods of the
+ interface in your program (nor the Thru), use schedule() with the current
+ time instead: an interrupted message would be mixed with the scheduled ones.
+
+ Size is the maximum number of pending messages (8 bytes each).
+ SysEx can't be scheduled.
+ */
+template<class Interface, byte Size = 16>
+class MIDI_Scheduler {
+
+public:
+
+	MIDI_Scheduler(Interface & inInterface) : mInterface(inInterface), mCount(0) { }
+
+	/*! \brief Send a message at the given time, returns false if the queue is full, the type is SysEx or the channel is not 1 to 16. */
+	bool schedule(unsigned long inTime, kMIDIType inType, byte inData1, byte inData2, byte inChannel) {
+		return schedule(inTime,makeEvent(inType,inData1,inData2,inChannel));
+	}
+
+	/*! \brief Send an event at the given time, returns false if the queue is full or the event is a SysEx. */
+	bool schedule(unsigned long inTime, const midievent & inEvent) {
+
+		if (inEvent.status == SystemExclusive || inEvent.status == InvalidType) return false;
+
+		bool queued = false;
+
+		MIDI_ATOMIC_BEGIN
+
+		if (mCount < Size) {
+
+			// Sorted by decreasing time, the next message is the last one.
+			// The messages with an earlier or equal time stay after the new one.
+			byte i = mCount;
+			while (i > 0 && !is_before(inTime,mQueue[i-1].time)) i--;
+			for (byte j=mCount;j>i;j--) mQueue[j] = mQueue[j-1];
+
+			mQueue[i].time = inTime;
+			mQueue[i].event = inEvent;
+			mCount++;
+			queued = true;
+		}
+
+		MIDI_ATOMIC_END
+
+		return queued;
+	}
+
+	/*! \brief Send a note at the given time, and its Note Off inDuration later. Returns false if the queue is full. */
+	bool scheduleNote(unsigned long inTime, byte inNote, byte inVelocity, byte inChannel, unsigned long inDuration) {
+		if (getFree() < 2) return false;
+		return schedule(inTime,NoteOn,inNote,inVelocity,inChannel) && schedule(inTime + inDuration,NoteOff,inNote,0,inChannel);
+	}
+
+	/*! \brief Send the messages whose time has come (time <= inNow). */
+	void dispatch(unsigned long inNow) {
+
+		for (;;) {
+
+			Event event;
+			bool due;
+
+			MIDI_ATOMIC_BEGIN
+			due = (mCount > 0) && !is_before(inNow,mQueue[mCount-1].time);
+			if (due) event = mQueue[--mCount];
+			MIDI_ATOMIC_END
+
+			if (!due) return;
+
+			mInterface.forward(event.event.getType(),event.event.data1,event.event.data2,event.event.getChannel(),NULL);
+		}
+	}
+
+	/*! \brief Send the messages whose time has come, using MIDI_MICROS() as the current time. */
+	void dispatch() { dispatch(MIDI_MICROS()); }
+
+	/*! \brief Time of the next message to send, eg: to program a one-shot timer. Returns false if there is none.
+	 Safe while dispatch() runs in an interrupt: the queue is read with the interrupts disabled.
+	 */
+	bool getNextTime(unsigned long & outTime) const {
+		bool pending;
+		MIDI_ATOMIC_BEGIN
+		pending = (mCount != 0);
+		if (pending) outTime = mQueue[mCount-1].time;
+		MIDI_ATOMIC_END
+		return pending;
+	}
+
+	bool hasPending() const { return mCount != 0; }
+	byte getFree() const { return Size - mCount; }
+
+	/*! \brief Remove all the pending messages (beware of the pending Note Off). */
+	void clear() {
+		MIDI_ATOMIC_BEGIN
+		mCount = 0;
+		MIDI_ATOMIC_END
+	}
+
+private:
+
+	// Times wrap around (about 71 minutes in microseconds).
+	static bool is_before(unsigned long inA, unsigned long inB) { return (long)(inA - inB) < 0; }
+
+	struct Event {
+		unsigned long	time;
+		midievent		event;
+	};
+
+	Interface &		mInterface;
+	Event			mQueue[Size];
+	volatile byte	mCount;
+
+};
+
+
+#endif // LIB_MIDI_SCHEDULER_H_
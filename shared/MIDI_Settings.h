@@ -0,0 +1,84 @@
+/*!
+ *  @file		MIDI_Settings.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Compilation settings
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_SETTINGS_H_
+#define LIB_MIDI_SETTINGS_H_
+
+
+/*
+    ###############################################################
+    #                                                             #
+    #    CONFIGURATION AREA                                       #
+    #                                                             #
+    #    The settings are given to MIDI_Interface as a template   #
+    #    parameter, so each port can have its own configuration.  #
+    #    The values are compile-time constants: the code for the  #
+    #    disabled features is removed by the compiler, for each   #
+    #    instance separately.                                     #
+    #                                                             #
+    ###############################################################
+ */
+
+
+/*! \brief Default settings for MIDI_Interface.
+
+ To change them, derive from this structure and override the members you want:
+ \code
+ struct MySettings : public MIDI_DefaultSettings {
+ 	static const bool UseRunningStatus = false;
+ 	static const unsigned SysExMaxSize = 16;
+ };
+ MIDI_Interface<HardwareSerial, MySettings> midiB(Serial1);
+ \endcode
+ */
+struct MIDI_DefaultSettings {
+
+	/*! Running status enables short messages when sending multiple values
+	 of the same type and channel.
+	 Set to false if you have troubles with controlling you hardware. */
+	static const bool UseRunningStatus = true;
+
+	/*! Set to true to send the Note Off messages as Note On with a null velocity.
+	 Notes then share the same status byte, so running status applies to
+	 NoteOn/NoteOff sequences (2 bytes per note event instead of 3).
+	 The release velocity is lost, leave it to false if your receiver uses it. */
+	static const bool NoteOffAsNoteOn = false;
+
+	/*! Set to true if you want to use callback handlers (to bind your functions to the library). */
+	static const bool UseCallbacks = true;
+
+	/*! Set to true to use the MIDI Soft Thru feature (read() will send the filtered messages back on the output). */
+	static const bool Thru = true;
+
+	/*! Set to true to forward the received bytes to the output as soon as they arrive,
+	 instead of re-sending the complete messages (lower latency, SysEx is not buffered).
+	 Applies to the filter modes of the Thru, not to MIDI_Router. Don't send anything from
+	 your program while a message is being received, it would be mixed with the Thru output. */
+	static const bool ThruCutThrough = false;
+
+	/*! Maximum size of SysEx receivable (255 max).
+	 Decrease to save RAM if you don't expect to receive SysEx, or adjust accordingly. */
+	static const unsigned SysExMaxSize = 255;
+
+	/*! Size of the serial RX buffer, when it is full the parser flushes it. */
+	static const unsigned SerialBufferSize = 128;
+
+	/*! Set to true to count the received and sent messages, the parsing errors and the
+	 running status savings (see MIDI_Statistics). Costs about 100 bytes of RAM. */
+	static const bool UseStatistics = false;
+
+};
+
+
+// END OF CONFIGURATION AREA
+// (do not modify anything under this line unless you know what you are doing)
+
+
+#endif // LIB_MIDI_SETTINGS_H_
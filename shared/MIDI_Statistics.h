@@ -0,0 +1,101 @@
+/*!
+ *  @file		MIDI_Statistics.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Runtime statistics counters
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_STATISTICS_H_
+#define LIB_MIDI_STATISTICS_H_
+
+#include "MIDI_Defs.h"
+
+
+/*! \brief Counters of what a MIDI_Interface has received and sent.
+
+ Enable them with MIDI_DefaultSettings::UseStatistics, and take a snapshot
+ with getStatistics(). The counters wrap around when they overflow, take
+ snapshots and reset them (resetStatistics()) periodically on long runs.
+ */
+struct MIDI_Statistics {
+
+	/*! One counter per MIDI type, see getTypeSlot(). */
+	enum { NumTypeSlots = MIDI_NUM_TYPE_SLOTS };
+
+	uint16_t	rxMessages[NumTypeSlots];	///< Complete messages received, per type (before channel filtering)
+	uint16_t	txMessages[NumTypeSlots];	///< Messages sent, per type (Thru included), Note Off included when sent as Note On
+	uint16_t	rxErrors;					///< Parsing errors: undefined status, orphan data or EOX, interrupted messages
+	uint16_t	rxSysExOverflows;			///< SysEx dropped because longer than SysExMaxSize
+	uint16_t	rxBufferFlushes;			///< Serial RX buffer flushed because it was full
+	uint32_t	txRunningStatusSaved;		///< Status bytes not sent thanks to running status
+
+	/*! \brief Number of messages of type inType received. */
+	uint16_t received(kMIDIType inType) const { return (inType == InvalidType) ? 0 : rxMessages[getTypeSlot(inType)]; }
+
+	/*! \brief Number of messages of type inType sent. */
+	uint16_t sent(kMIDIType inType) const { return (inType == InvalidType) ? 0 : txMessages[getTypeSlot(inType)]; }
+
+	void reset() {
+		for (byte i=0;i<NumTypeSlots;i++) {
+			rxMessages[i] = 0;
+			txMessages[i] = 0;
+		}
+		rxErrors = 0;
+		rxSysExOverflows = 0;
+		rxBufferFlushes = 0;
+		txRunningStatusSaved = 0;
+	}
+
+};
+
+
+/*! \brief Storage and update of the statistics, used internally by MIDI_Parser and MIDI_Interface.
+
+ The disabled version (Enabled = false) has no storage and its methods are empty,
+ so the counting code is removed by the compiler.
+ */
+template<bool Enabled>
+class MIDI_StatisticsCounter {
+
+public:
+
+	MIDI_StatisticsCounter() { mCounters.reset(); }
+
+	void snapshot(MIDI_Statistics & outStats) const { outStats = mCounters; }
+	void reset() { mCounters.reset(); }
+
+	void received(kMIDIType inType) { if (inType != InvalidType) mCounters.rxMessages[getTypeSlot(inType)]++; }
+	void sent(kMIDIType inType) { if (inType != InvalidType) mCounters.txMessages[getTypeSlot(inType)]++; }
+	void parseError() { mCounters.rxErrors++; }
+	void sysexOverflow() { mCounters.rxSysExOverflows++; }
+	void bufferFlush() { mCounters.rxBufferFlushes++; }
+	void runningStatusHit() { mCounters.txRunningStatusSaved++; }
+
+private:
+
+	MIDI_Statistics		mCounters;
+
+};
+
+template<>
+class MIDI_StatisticsCounter<false> {
+
+public:
+
+	void snapshot(MIDI_Statistics & outStats) const { outStats.reset(); }
+	void reset() { }
+
+	void received(kMIDIType) { }
+	void sent(kMIDIType) { }
+	void parseError() { }
+	void sysexOverflow() { }
+	void bufferFlush() { }
+	void runningStatusHit() { }
+
+};
+
+
+#endif // LIB_MIDI_STATISTICS_H_
@@ -0,0 +1,68 @@
+/*!
+ *  @file		MIDI_Time.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - Time source of the time based features
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_TIME_H_
+#define LIB_MIDI_TIME_H_
+
+
+/*
+    ###############################################################
+    #                                                             #
+    #    TIME SOURCE                                              #
+    #                                                             #
+    #    MIDI_MILLIS() and MIDI_MICROS() return the time in ms    #
+    #    and us (unsigned long, wrapping around). They use the    #
+    #    Arduino core (Teensy included) by default. On other      #
+    #    platforms (avr_core, host), define them before           #
+    #    including the library, otherwise the time based         #
+    #    features (status refresh, timeouts...) never trigger.    #
+    #                                                             #
+    ###############################################################
+ */
+
+#if defined(ARDUINO) && (!defined(MIDI_MILLIS) || !defined(MIDI_MICROS))
+#include "wiring.h"
+#endif
+
+#ifndef MIDI_MILLIS
+#if defined(ARDUINO)
+#define MIDI_MILLIS()			millis()
+#else
+#define MIDI_MILLIS()			0UL
+#endif
+#endif
+
+#ifndef MIDI_MICROS
+#if defined(ARDUINO)
+#define MIDI_MICROS()			micros()
+#else
+#define MIDI_MICROS()			0UL
+#endif
+#endif
+
+
+/*
+ MIDI_ATOMIC_BEGIN / MIDI_ATOMIC_END protect the data shared with the timer
+ interrupts (scheduler, clock), by disabling the interrupts in between.
+ */
+#ifndef MIDI_ATOMIC_BEGIN
+#if defined(__AVR__)
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#define MIDI_ATOMIC_BEGIN		{ const uint8_t midi_atomic_sreg = SREG; cli();
+#define MIDI_ATOMIC_END			SREG = midi_atomic_sreg; }
+#else
+#define MIDI_ATOMIC_BEGIN		{
+#define MIDI_ATOMIC_END			}
+#endif
+#endif
+
+
+#endif // LIB_MIDI_TIME_H_
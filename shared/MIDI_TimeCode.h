@@ -0,0 +1,351 @@
+/*!
+ *  @file		MIDI_TimeCode.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - MIDI Time Code (MTC) reader and generator
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_TIMECODE_H_
+#define LIB_MIDI_TIMECODE_H_
+
+#include "MIDI_Defs.h"
+#include "MIDI_Time.h"
+
+
+/*! Frame rates of the MIDI Time Code (as coded in the hours). */
+enum kMTCRate {
+	MTC24		= 0,	///< 24 fps (film)
+	MTC25		= 1,	///< 25 fps (EBU)
+	MTC30Drop	= 2,	///< 29.97 fps, drop frame (NTSC)
+	MTC30		= 3		///< 30 fps
+};
+
+
+/*! \brief A SMPTE time code: hours, minutes, seconds, frames and frame rate. */
+struct MIDI_TimeCode {
+	byte		hours;		///< 0 to 23
+	byte		minutes;	///< 0 to 59
+	byte		seconds;	///< 0 to 59
+	byte		frames;		///< 0 to 23, 24 or 29 depending on the rate
+	kMTCRate	rate;
+
+	/*! \brief Number of frames per second (30 for the drop frame rate: it drops frame numbers, not frames). */
+	byte getFramesPerSecond() const { return (rate == MTC24) ? 24 : (rate == MTC25) ? 25 : 30; }
+
+	/*! \brief Move to the next frame, skipping the frame numbers dropped in drop frame. */
+	void increment() {
+		if (++frames < getFramesPerSecond()) return;
+		frames = 0;
+		if (++seconds < 60) return;
+		seconds = 0;
+		if (++minutes < 60) {
+			if (rate == MTC30Drop && (minutes % 10) != 0) frames = 2;
+			return;
+		}
+		minutes = 0;
+		if (++hours >= 24) hours = 0;
+	}
+
+	/*! \brief Move to the previous frame, skipping the frame numbers dropped in drop frame. */
+	void decrement() {
+		const byte first = (rate == MTC30Drop && seconds == 0 && (minutes % 10) != 0) ? 2 : 0;
+		if (frames > first) {
+			frames--;
+			return;
+		}
+		frames = getFramesPerSecond() - 1;
+		if (seconds-- > 0) return;
+		seconds = 59;
+		if (minutes-- > 0) return;
+		minutes = 59;
+		if (hours-- > 0) return;
+		hours = 23;
+	}
+
+	/*! \brief Value of a quarter frame piece (0 to 7) of this time code. */
+	byte getPiece(byte inPiece) const {
+		switch (inPiece) {
+			case 0: return frames & 0x0F;
+			case 1: return frames >> 4;
+			case 2: return seconds & 0x0F;
+			case 3: return seconds >> 4;
+			case 4: return minutes & 0x0F;
+			case 5: return minutes >> 4;
+			case 6: return hours & 0x0F;
+			default: return ((hours >> 4) & 0x01) | (rate << 1);
+		}
+	}
+};
+
+
+/*! \brief MIDI Time Code reader: assembles the quarter frames and the Full Frame messages into time codes.
+
+ Attach it to the interface receiving the MTC with setTimeCodeReader(): the
+ quarter frames and the Full Frame SysEx are passed to it by read(). A
+ complete time code is known after 8 quarter frames (2 frames), in both
+ directions (the direction is given by the order of the pieces). Then the
+ frame callback is called on each frame, with the current time code:
+ compensated for the 2 frames it takes to send it, and updated between the
+ complete time codes.
+ \code
+ MIDI_TimeCodeReader mtc;
+
+ void handleFrame(const MIDI_TimeCode & inTimeCode) { ... }
+
+ void setup() {
+ 	MIDI.begin();
+ 	MIDI.setTimeCodeReader(&mtc);
+ 	mtc.setHandleFrame(handleFrame);
+ }
+ \endcode
+ A Full Frame message (locate) sets the time code immediately, and stops the
+ quarter frames assembly until the next sequence.
+ */
+class MIDI_TimeCodeReader {
+
+public:
+
+	MIDI_TimeCodeReader() : mFrameCallback(NULL) { reset(); }
+
+	/*! \brief Forget the time code (eg: when the source changes). */
+	void reset() {
+		mCount = 0;
+		mLastPiece = 0;
+		mForward = true;
+		mLocked = false;
+		mTimeCode.hours = mTimeCode.minutes = mTimeCode.seconds = mTimeCode.frames = 0;
+		mTimeCode.rate = MTC24;
+	}
+
+	/*! \brief Called on each frame, with the current time code. */
+	void setHandleFrame(void (*fptr)(const MIDI_TimeCode & timecode)) { mFrameCallback = fptr; }
+
+	/*! \brief Process a quarter frame (the data byte of a Time Code Quarter Frame message). */
+	void quarterFrame(byte inData) {
+
+		const byte piece = (inData >> 4) & 0x07;
+		const byte value = inData & 0x0F;
+
+		// Direction and continuity: the pieces follow each other, one way or the other.
+		const bool forward = (piece == ((mLastPiece + 1) & 0x07));
+		const bool backward = (piece == ((mLastPiece - 1) & 0x07));
+		if (mCount > 0 && (forward || backward)) {
+			if (forward != mForward) {
+				mForward = forward;		// Direction change: assemble again.
+				mCount = 1;
+			}
+		}
+		else {
+			mCount = 0;					// First piece, or a piece was lost.
+			mLocked = false;
+		}
+		mLastPiece = piece;
+		mPieces[piece] = value;
+		if (mCount < 8) mCount++;
+
+		// The last piece of a sequence completes a time code.
+		if (mCount < 8 || piece != (mForward ? 7 : 0)) {
+			// A frame passes every 4 quarter frames: keep the time code running in between.
+			if (mLocked && piece == (mForward ? 3 : 4)) step();
+			return;
+		}
+
+		mTimeCode.frames = mPieces[0] | ((mPieces[1] & 0x01) << 4);
+		mTimeCode.seconds = mPieces[2] | ((mPieces[3] & 0x03) << 4);
+		mTimeCode.minutes = mPieces[4] | ((mPieces[5] & 0x03) << 4);
+		mTimeCode.hours = mPieces[6] | ((mPieces[7] & 0x01) << 4);
+		mTimeCode.rate = (kMTCRate)((mPieces[7] >> 1) & 0x03);
+
+		// The time code was the time of the first piece, 2 frames ago.
+		mLocked = true;
+		if (mForward) {
+			mTimeCode.increment();
+			mTimeCode.increment();
+		}
+		else {
+			mTimeCode.decrement();
+			mTimeCode.decrement();
+		}
+		if (mFrameCallback != NULL) mFrameCallback(mTimeCode);
+	}
+
+	/*! \brief Process a SysEx: Full Frame messages (F0 7F id 01 01 hr mn sc fr F7) locate the time code. */
+	void sysEx(const byte * inArray, byte inLength) {
+
+		if (inLength != 10 || inArray[1] != 0x7F || inArray[3] != 0x01 || inArray[4] != 0x01) return;
+
+		mTimeCode.hours = inArray[5] & 0x1F;
+		mTimeCode.rate = (kMTCRate)((inArray[5] >> 5) & 0x03);
+		mTimeCode.minutes = inArray[6] & 0x3F;
+		mTimeCode.seconds = inArray[7] & 0x3F;
+		mTimeCode.frames = inArray[8] & 0x1F;
+		mCount = 0;
+		mLocked = false;
+		if (mFrameCallback != NULL) mFrameCallback(mTimeCode);
+	}
+
+	/*! \brief Called by MIDI_Interface::read() with the received messages. */
+	void received(kMIDIType inType, byte inData1, const byte * inSysEx) {
+		if (inType == TimeCodeQuarterFrame) quarterFrame(inData1);
+		else if (inType == SystemExclusive) sysEx(inSysEx,inData1);
+	}
+
+	/*! \brief Current time code (valid when isLocked(), or after a Full Frame). */
+	const MIDI_TimeCode & getTimeCode() const { return mTimeCode; }
+
+	/*! \brief True when the quarter frames are running and a complete time code was received. */
+	bool isLocked() const { return mLocked; }
+
+	/*! \brief Direction of the quarter frames: false when the time code runs backwards. */
+	bool isForward() const { return mForward; }
+
+private:
+
+	// Next frame in the current direction, between the complete time codes.
+	void step() {
+		if (mForward) mTimeCode.increment();
+		else mTimeCode.decrement();
+		if (mFrameCallback != NULL) mFrameCallback(mTimeCode);
+	}
+
+	byte			mPieces[8];
+	byte			mCount;			// Pieces received in sequence, up to 8.
+	byte			mLastPiece;
+	bool			mForward;
+	bool			mLocked;
+
+	MIDI_TimeCode	mTimeCode;
+
+	void (*mFrameCallback)(const MIDI_TimeCode & timecode);
+
+};
+
+
+/*! \brief MIDI Time Code generator: sends the quarter frames of a running time code.
+
+ The time is given to tick(), by a timer interrupt with its period, or by
+ update() in loop(), as MIDI_ClockMaster. The quarter frame period is
+ accumulated exactly, including for 29.97 fps (drop frame).
+ \code
+ MIDI_TimeCodeGenerator<MIDI_Class> mtc(MIDI);
+
+ ISR(TIMER2_COMPA_vect) { mtc.tick(250); }
+
+ void setup() {
+ 	MIDI.begin();
+ 	MIDI_TimeCode start = { 1, 0, 0, 0, MTC25 };		// 01:00:00:00 at 25 fps
+ 	mtc.locate(start);
+ 	mtc.start();
+ }
+ \endcode
+ Quarter frames are System Common messages: when tick() runs in an interrupt,
+ don't send other messages from the program, as for MIDI_Scheduler.
+ */
+template<class Interface>
+class MIDI_TimeCodeGenerator {
+
+public:
+
+	MIDI_TimeCodeGenerator(Interface & inInterface) : mInterface(inInterface), mAccumulator(0), mPiece(0), mRunning(false), mLastUpdate(0), mUpdated(false) {
+		mTimeCode.hours = mTimeCode.minutes = mTimeCode.seconds = mTimeCode.frames = 0;
+		mTimeCode.rate = MTC24;
+	}
+
+	/*! \brief Move to a time code and send it in a Full Frame message (the time code of the next quarter frames). */
+	void locate(const MIDI_TimeCode & inTimeCode) {
+
+		MIDI_ATOMIC_BEGIN
+		mTimeCode = inTimeCode;
+		mPiece = 0;
+		mAccumulator = 0;
+		MIDI_ATOMIC_END
+		mLastUpdate = MIDI_MICROS();
+
+		byte fullframe[8] = { 0x7F, 0x7F, 0x01, 0x01,
+							 (byte)((inTimeCode.rate << 5) | (inTimeCode.hours & 0x1F)),
+							 inTimeCode.minutes, inTimeCode.seconds, inTimeCode.frames };
+		mInterface.sendSysEx(8,fullframe);
+	}
+
+	/*! \brief Start sending the quarter frames, from the current time code. */
+	void start() {
+		MIDI_ATOMIC_BEGIN
+		mRunning = true;
+		MIDI_ATOMIC_END
+		mLastUpdate = MIDI_MICROS();
+	}
+
+	/*! \brief Stop sending the quarter frames, the time code stays where it was. */
+	void stop() {
+		MIDI_ATOMIC_BEGIN
+		mRunning = false;
+		mPiece = 0;
+		MIDI_ATOMIC_END
+	}
+
+	bool isRunning() const { return mRunning; }
+
+	/*! \brief Time code of the current sequence of quarter frames (the time of its first piece). */
+	MIDI_TimeCode getTimeCode() const {
+		MIDI_TimeCode timecode;
+		MIDI_ATOMIC_BEGIN
+		timecode = mTimeCode;
+		MIDI_ATOMIC_END
+		return timecode;
+	}
+
+	/*! \brief Advance the time by inElapsed microseconds, and send the quarter frames that are due. */
+	void tick(uint16_t inElapsed) {
+
+		if (!mRunning) return;
+
+		// Quarter frame period: 250000 / fps us, with fps = 30000/1001 in drop frame.
+		const bool ntsc = (mTimeCode.rate == MTC30Drop);
+		const uint32_t threshold = ntsc ? 250250000UL : 250000UL;
+		mAccumulator += (uint32_t)inElapsed * (ntsc ? 30000U : mTimeCode.getFramesPerSecond());
+
+		while (mAccumulator >= threshold) {
+			mAccumulator -= threshold;
+			mInterface.sendTimeCodeQuarterFrame(mPiece,mTimeCode.getPiece(mPiece));
+			if (++mPiece == 8) {
+				mPiece = 0;
+				mTimeCode.increment();
+				mTimeCode.increment();
+			}
+		}
+	}
+
+	/*! \brief Send the quarter frames that are due since the last call, using MIDI_MICROS(). Call it in loop(), if tick() is not called by a timer.
+
+	 The time counts from the first call, and from locate() and start().
+	 */
+	void update() {
+		const unsigned long now = MIDI_MICROS();
+		unsigned long elapsed = mUpdated ? now - mLastUpdate : 0;
+		mLastUpdate = now;
+		mUpdated = true;
+		while (elapsed > 0xFFFF) {
+			tick(0xFFFF);
+			elapsed -= 0xFFFF;
+		}
+		tick((uint16_t)elapsed);
+	}
+
+private:
+
+	Interface &				mInterface;
+
+	MIDI_TimeCode			mTimeCode;
+	volatile uint32_t		mAccumulator;
+	volatile byte			mPiece;			// Next piece to send
+	volatile bool			mRunning;
+	unsigned long			mLastUpdate;
+	bool					mUpdated;		// update() was called, mLastUpdate is valid
+
+};
+
+
+#endif // LIB_MIDI_TIMECODE_H_
@@ -0,0 +1,290 @@
+/*!
+ *  @file		MIDI_UMP.h
+ *  Project		MIDI Library
+ *	@brief		MIDI Library - MIDI 2.0 Universal MIDI Packets
+ *	Version		3.2
+ *  @author		Francois Best
+ *	@date		24/02/11
+ *  License		GPL Forty Seven Effects - 2011
+ */
+
+#ifndef LIB_MIDI_UMP_H_
+#define LIB_MIDI_UMP_H_
+
+#include "MIDI_Defs.h"
+
+
+/*! Message types of the Universal MIDI Packets (4 most significant bits of the first word). */
+enum kUMPType {
+	UMPUtility			= 0x0,	///< 32 bits: NOOP, JR Clock, JR Timestamp
+	UMPSystem			= 0x1,	///< 32 bits: System Common and Real Time
+	UMPChannelVoice1	= 0x2,	///< 32 bits: MIDI 1.0 Channel Voice
+	UMPData64			= 0x3,	///< 64 bits: 7-bit SysEx
+	UMPChannelVoice2	= 0x4,	///< 64 bits: MIDI 2.0 Channel Voice
+	UMPData128			= 0x5	///< 128 bits: 8-bit SysEx and Mixed Data Set
+};
+
+
+/*! \brief A Universal MIDI Packet (MIDI 2.0): 1 to 4 32-bit words, the size depends on the message type.
+
+ Conversions from and to the MIDI 1.0 messages (kMIDIType, as in midimsg),
+ as MIDI 1.0 Channel Voice packets (MT 2), or MIDI 2.0 Channel Voice
+ packets (MT 4) with the values scaled up to 16 and 32 bits (min-center-max
+ scaling of the MIDI 2.0 specification), and back.
+ \code
+ MIDI_UMP packet;
+ if (MIDI.read() && packet.fromMessage(MIDI.getMessage(),0,true)) usb.write(packet.word,packet.getSize());
+
+ // And back
+ if (packet.toMessage(message)) MIDI.forward(message.type,message.data1,message.data2,message.channel,message.sysex_array);
+ \endcode
+ SysEx are carried by several packets (MT 3, 6 bytes each): see fromSysEx()
+ and toMessage(), which assembles them.
+ */
+struct MIDI_UMP {
+
+	uint32_t	word[4];
+
+	/*! \brief Message type (kUMPType). */
+	byte getType() const { return word[0] >> 28; }
+
+	/*! \brief Group (0 to 15): the 16 groups of 16 channels of a UMP endpoint. */
+	byte getGroup() const { return (word[0] >> 24) & 0x0F; }
+
+	/*! \brief Number of 32-bit words of the packet, from its type. */
+	byte getSize() const { return getSize(getType()); }
+
+	static byte getSize(byte inType) {
+		// 4 bits per message type, 0x0 to 0x7.
+		static const uint32_t sizes = 0x11422111UL;		// Types 0x7 to 0x0: 1,1,4,2,2,1,1,1
+		if (inType < 8) return (sizes >> (inType * 4)) & 0x0F;
+		return (inType < 0xB) ? 2 : (inType < 0xD) ? 3 : 4;
+	}
+
+
+	/* ####### MIDI 1.0 -> UMP ####### */
+
+	/*! \brief Build the packet of a MIDI 1.0 message (no SysEx, see fromSysEx()).
+	 \param inGroup	The group of the packet (0 to 15).
+	 \param inMIDI2	Channel messages as MIDI 2.0 Channel Voice (MT 4, high resolution), or MIDI 1.0 Channel Voice (MT 2).
+	 Returns false for SysEx and invalid types.
+	 */
+	bool fromMessage(kMIDIType inType, byte inData1, byte inData2, byte inChannel, byte inGroup, bool inMIDI2) {
+
+		if (inType == SystemExclusive || inType == InvalidType) return false;
+
+		inData1 &= 0x7F;
+		inData2 &= 0x7F;
+		const uint32_t group = (uint32_t)(inGroup & 0x0F) << 24;
+
+		if (inType >= TimeCodeQuarterFrame) {
+			if (inType != SongPosition) inData2 = 0;
+			if (inType >= TuneRequest) inData1 = 0;
+			word[0] = ((uint32_t)UMPSystem << 28) | group | ((uint32_t)inType << 16) | ((uint16_t)inData1 << 8) | inData2;
+			return true;
+		}
+
+		const uint32_t status = (uint32_t)(inType | ((inChannel - 1) & 0x0F)) << 16;
+
+		if (!inMIDI2) {
+			if (inType == ProgramChange || inType == AfterTouchChannel) inData2 = 0;
+			word[0] = ((uint32_t)UMPChannelVoice1 << 28) | group | status | ((uint16_t)inData1 << 8) | inData2;
+			return true;
+		}
+
+		word[0] = ((uint32_t)UMPChannelVoice2 << 28) | group;
+		switch (inType) {
+			case NoteOn:
+				if (inData2 == 0) {		// MIDI 1.0 Note Off
+					word[0] |= status ^ 0x100000UL;
+					word[1] = 0;
+					word[0] |= (uint16_t)inData1 << 8;
+					return true;
+				}
+				// fall through
+			case NoteOff:
+				word[0] |= status | ((uint16_t)inData1 << 8);
+				word[1] = (uint32_t)scale7to16(inData2) << 16;
+				break;
+			case AfterTouchPoly:
+			case ControlChange:
+				word[0] |= status | ((uint16_t)inData1 << 8);
+				word[1] = scale7to32(inData2);
+				break;
+			case ProgramChange:
+				word[0] |= status;
+				word[1] = (uint32_t)inData1 << 24;
+				break;
+			case AfterTouchChannel:
+				word[0] |= status;
+				word[1] = scale7to32(inData1);
+				break;
+			default:	// PitchBend
+				word[0] |= status;
+				word[1] = scale14to32(((uint16_t)inData2 << 7) | inData1);
+				break;
+		}
+		return true;
+	}
+
+	/*! \brief Build the packet of a received MIDI 1.0 message (no SysEx, see fromSysEx()). */
+	template<unsigned SysExSize>
+	bool fromMessage(const midimsg<SysExSize> & inMessage, byte inGroup, bool inMIDI2) {
+		return fromMessage(inMessage.type,inMessage.data1,inMessage.data2,inMessage.channel,inGroup,inMIDI2);
+	}
+
+	/*! \brief Build the next SysEx packet (MT 3, up to 6 bytes) of a SysEx.
+	 \param inData		The SysEx bytes, without the 0xF0 and 0xF7 boundaries.
+	 \param inLength	The number of bytes of inData.
+	 \param inOffset	The offset of the packet in inData: 0 for the first one, then the returned value.
+	 \param inGroup		The group of the packet (0 to 15).
+	 Returns the offset of the next packet, inLength after the last one.
+	 \code
+	 byte offset = 0;
+	 do {
+	 	offset = packet.fromSysEx(data,length,offset,0);
+	 	usb.write(packet.word,2);
+	 } while (offset < length);
+	 \endcode
+	 */
+	byte fromSysEx(const byte * inData, byte inLength, byte inOffset, byte inGroup) {
+
+		const byte count = (inLength - inOffset > 6) ? 6 : inLength - inOffset;
+		const bool first = (inOffset == 0);
+		const bool last = (inOffset + count >= inLength);
+		// Status: 0 complete, 1 start, 2 continue, 3 end.
+		const byte status = first ? (last ? 0 : 1) : (last ? 3 : 2);
+
+		byte bytes[6] = { 0, 0, 0, 0, 0, 0 };
+		for (byte i=0;i<count;i++) bytes[i] = inData[inOffset + i] & 0x7F;
+
+		word[0] = ((uint32_t)UMPData64 << 28) | ((uint32_t)(inGroup & 0x0F) << 24) | ((uint32_t)status << 20) | ((uint32_t)count << 16) | ((uint16_t)bytes[0] << 8) | bytes[1];
+		word[1] = ((uint32_t)bytes[2] << 24) | ((uint32_t)bytes[3] << 16) | ((uint16_t)bytes[4] << 8) | bytes[5];
+		return inOffset + count;
+	}
+
+
+	/* ####### UMP -> MIDI 1.0 ####### */
+
+	/*! \brief Convert the packet to a MIDI 1.0 message (values scaled down), returns true when a message is complete.
+
+	 SysEx packets (MT 3) are assembled in outMessage (0xF0 and 0xF7
+	 included, truncated to SysExSize): keep the same outMessage for all the
+	 packets of a group, the message is complete with the last packet.
+	 Returns false for the packets which have no MIDI 1.0 equivalent
+	 (Utility, MIDI 2.0 per-note and registered controllers...).
+	 */
+	template<unsigned SysExSize>
+	bool toMessage(midimsg<SysExSize> & outMessage) const {
+
+		const byte type = getType();
+		const byte status = (word[0] >> 16) & 0xFF;
+		const byte data1 = (word[0] >> 8) & 0x7F;
+		const byte data2 = word[0] & 0x7F;
+
+		switch (type) {
+
+			case UMPSystem:
+				// Not SysEx (0xF0, 0xF7), nor the undefined statuses.
+				if (status < TimeCodeQuarterFrame || status == 0xF4 || status == 0xF5 || status == 0xF7 || status == 0xF9 || status == 0xFD) return false;
+				return set_message(outMessage,(kMIDIType)status,(status >= TuneRequest) ? 0 : data1,(status == SongPosition) ? data2 : 0,0);
+
+			case UMPChannelVoice1:
+				if (status < 0x80 || status >= 0xF0) return false;
+				return set_message(outMessage,(kMIDIType)(status & 0xF0),data1,data2,(status & 0x0F) + 1);
+
+			case UMPChannelVoice2: {
+				const kMIDIType kind = (kMIDIType)(status & 0xF0);
+				const byte channel = (status & 0x0F) + 1;
+				switch (kind) {
+					case NoteOff:
+					case NoteOn: {
+						byte velocity = word[1] >> 25;
+						if (kind == NoteOn && velocity == 0) velocity = 1;		// Velocity 0 is not a Note Off in MIDI 2.0.
+						return set_message(outMessage,kind,data1,velocity,channel);
+					}
+					case AfterTouchPoly:
+					case ControlChange:		return set_message(outMessage,kind,data1,word[1] >> 25,channel);
+					case ProgramChange:		return set_message(outMessage,kind,(word[1] >> 24) & 0x7F,0,channel);
+					case AfterTouchChannel:	return set_message(outMessage,kind,word[1] >> 25,0,channel);
+					case PitchBend: {
+						const uint16_t bend = word[1] >> 18;
+						return set_message(outMessage,kind,bend & 0x7F,bend >> 7,channel);
+					}
+					default:				return false;
+				}
+			}
+
+			case UMPData64: {
+				const byte sysex_status = (word[0] >> 20) & 0x0F;
+				byte count = (word[0] >> 16) & 0x0F;
+				if (count > 6 || sysex_status > 3) return false;
+
+				// Start or complete: new SysEx. Continue or end: only after a start.
+				if (sysex_status <= 1) {
+					outMessage.type = SystemExclusive;
+					outMessage.sysex_array[0] = 0xF0;
+					outMessage.data1 = 1;
+				}
+				else if (outMessage.type != SystemExclusive || outMessage.valid) return false;
+				outMessage.valid = false;
+
+				const byte bytes[6] = { (byte)(word[0] >> 8), (byte)word[0], (byte)(word[1] >> 24), (byte)(word[1] >> 16), (byte)(word[1] >> 8), (byte)word[1] };
+				for (byte i=0;i<count && outMessage.data1 < SysExSize - 1;i++) outMessage.sysex_array[outMessage.data1++] = bytes[i] & 0x7F;
+
+				if (sysex_status == 0 || sysex_status == 3) {
+					outMessage.sysex_array[outMessage.data1++] = 0xF7;
+					outMessage.data2 = 0;
+					outMessage.channel = 0;
+					outMessage.valid = true;
+					return true;
+				}
+				return false;
+			}
+
+			default:
+				return false;
+		}
+	}
+
+
+	/* ####### Scaling (MIDI 2.0 min-center-max) ####### */
+
+	/*! \brief Scale a 7-bit value to 16 bits: 0, 64 and 127 give 0, 0x8000 and 0xFFFF. */
+	static uint16_t scale7to16(byte inValue) {
+		// Above the center, the 6 lower bits are repeated in the new bits (no branch: masked).
+		const uint16_t repeat = inValue & 0x3F;
+		const uint16_t mask = -(uint16_t)(inValue > 64);
+		return ((uint16_t)inValue << 9) | (((repeat << 3) | (repeat >> 3)) & mask);
+	}
+
+	/*! \brief Scale a 7-bit value to 32 bits: 0, 64 and 127 give 0, 0x80000000 and 0xFFFFFFFF. */
+	static uint32_t scale7to32(byte inValue) {
+		const uint32_t repeat = inValue & 0x3F;
+		const uint32_t mask = -(uint32_t)(inValue > 64);
+		return ((uint32_t)inValue << 25) | (((repeat << 19) | (repeat << 13) | (repeat << 7) | (repeat << 1) | (repeat >> 5)) & mask);
+	}
+
+	/*! \brief Scale a 14-bit value to 32 bits: 0, 8192 and 16383 give 0, 0x80000000 and 0xFFFFFFFF. */
+	static uint32_t scale14to32(uint16_t inValue) {
+		const uint32_t repeat = inValue & 0x1FFF;
+		const uint32_t mask = -(uint32_t)(inValue > 8192);
+		return ((uint32_t)inValue << 18) | (((repeat << 5) | (repeat >> 8)) & mask);
+	}
+
+private:
+
+	template<unsigned SysExSize>
+	static bool set_message(midimsg<SysExSize> & outMessage, kMIDIType inType, byte inData1, byte inData2, byte inChannel) {
+		outMessage.type = inType;
+		outMessage.data1 = inData1;
+		outMessage.data2 = inData2;
+		outMessage.channel = inChannel;
+		outMessage.valid = true;
+		return true;
+	}
+
+};
+
+
+#endif // LIB_MIDI_UMP_H_